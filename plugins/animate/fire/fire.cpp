@@ -1,7 +1,7 @@
 #include "fire.hpp"
 #include "particle.hpp"
 
-#include <thread>
+#include <random>
 #include <wayfire/output.hpp>
 #include <wayfire/core.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -10,9 +10,11 @@ static wf::option_wrapper_t<int> fire_particles{"animate/fire_particles"};
 static wf::option_wrapper_t<double> fire_particle_size{"animate/fire_particle_size"};
 
 // generate a random float between s and e
+// particles are initialized in parallel, so each thread has its own generator
 static float random(float s, float e)
 {
-    double r = 1.0 * (std::rand() % RAND_MAX) / (RAND_MAX - 1);
+    static thread_local std::minstd_rand generator{std::random_device{}()};
+    double r = std::uniform_real_distribution<double>{0, 1}(generator);
     return (s * r + (1 - r) * e);
 }
 
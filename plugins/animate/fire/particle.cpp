@@ -1,37 +1,14 @@
 #include "particle.hpp"
 #include "shaders.hpp"
 #include <wayfire/core.hpp>
-#include <thread>
+#include <wayfire/thread-pool.hpp>
 #include <wayfire/debug.hpp>
+#include <algorithm>
+#include <cmath>
 
-void Particle::update(float time)
-{
-    if (life <= 0) // ignore
-        return;
-
-    const float slowdown = 0.8;
-
-    pos += speed * 0.2f * slowdown;
-    speed += g * 0.3f * slowdown;
-
-    if (life != 0)
-        color.a /= life;
-
-    life -= fade * 0.3 * slowdown;
-    radius = base_radius * std::pow(life, 0.5);
-    color.a *= life;
-
-    if (start_pos.x < pos.x)
-        g.x = -1;
-    else
-        g.x = 1;
-
-    if (life <= 0)
-    {
-        /* move outside */
-        pos = {-10000, -10000};
-    }
-}
+/* Minimal number of particles processed by a single task, so that small
+ * systems are not split into tasks which are cheaper than their overhead */
+static constexpr size_t PARTICLES_PER_TASK = 256;
 
 ParticleSystem::ParticleSystem(int particles, ParticleIniter init_func)
 {
@@ -51,95 +28,168 @@ ParticleSystem::~ParticleSystem()
     OpenGL::render_end();
 }
 
+void ParticleSystem::spawn_at(int i)
+{
+    Particle p;
+    pinit_func(p);
+
+    life[i] = p.life;
+    fade[i] = p.fade;
+    base_radius[i] = p.base_radius;
+    radius[i] = p.radius;
+
+    pos_x[i] = p.pos.x;
+    pos_y[i] = p.pos.y;
+    speed_x[i] = p.speed.x;
+    speed_y[i] = p.speed.y;
+    g_x[i] = p.g.x;
+    g_y[i] = p.g.y;
+    start_x[i] = p.start_pos.x;
+    alpha[i] = p.color.a;
+
+    center[2 * i] = p.pos.x;
+    center[2 * i + 1] = p.pos.y;
+    for (int j = 0; j < 4; j++)
+    {
+        color[4 * i + j] = p.color[j];
+        dark_color[4 * i + j] = p.color[j] * 0.5;
+    }
+}
+
 int ParticleSystem::spawn(int num)
 {
-    // TODO: multithread this
-    int spawned = 0;
-    for (size_t i = 0; i < ps.size() && spawned < num; i++)
+    /* Number of particles which may still be spawned */
+    std::atomic<int> budget{num};
+    std::atomic<int> spawned{0};
+
+    wf::get_thread_pool().parallel_for(0, num_particles, [&] (size_t start, size_t end)
     {
-        if (ps[i].life <= 0)
+        for (size_t i = start; i < end && budget > 0; i++)
         {
-            pinit_func(ps[i]);
-            ++spawned;
-            ++particles_alive;
+            if (life[i] <= 0 && budget-- > 0)
+            {
+                spawn_at(i);
+                ++spawned;
+                ++particles_alive;
+            }
         }
-    }
+    }, PARTICLES_PER_TASK);
 
     return spawned;
 }
 
 void ParticleSystem::resize(int num)
 {
-    if (num == (int)ps.size())
+    if (num == num_particles)
         return;
 
-    // TODO: multithread this
-    for (int i = num; i < (int)ps.size(); i++)
+    for (int i = num; i < num_particles; i++)
     {
-        if (ps[i].life >= 0)
+        if (life[i] > 0)
             --particles_alive;
     }
 
-    ps.resize(num);
+    num_particles = num;
+    /* New particles are dead until spawned */
+    life.resize(num, -1);
+    for (auto array : {&fade, &base_radius, &pos_x, &pos_y, &speed_x,
+        &speed_y, &g_x, &g_y, &start_x, &alpha, &radius})
+    {
+        array->resize(num, 0);
+    }
 
     color.resize(color_per_particle * num);
     dark_color.resize(color_per_particle * num);
-    radius.resize(radius_per_particle * num);
     center.resize(center_per_particle * num);
 }
 
 int ParticleSystem::size()
 {
-    return ps.size();
+    return num_particles;
 }
 
-void ParticleSystem::update_worker(float time, int start, int end)
+/*
+ * The update kernel. It runs over plain float arrays without any control flow:
+ * dead particles are masked out arithmetically instead of skipped, so that the
+ * compiler can vectorize the loop for the target's SIMD instruction set.
+ *
+ * The arrays are passed as __restrict parameters, since GCC ignores __restrict
+ * on local pointers and would otherwise need too many run-time alias checks
+ * to vectorize the loop. Returns the number of particles which died.
+ */
+static int update_kernel(int start, int end,
+    float *__restrict life, const float *__restrict fade,
+    const float *__restrict base_radius,
+    float *__restrict pos_x, float *__restrict pos_y,
+    float *__restrict speed_x, float *__restrict speed_y,
+    float *__restrict g_x, const float *__restrict g_y,
+    const float *__restrict start_x,
+    float *__restrict alpha, float *__restrict radius)
 {
-    end = std::min(end, (int)ps.size());
+    const float slowdown = 0.8;
+    const float speed_factor = 0.2 * slowdown;
+    const float g_factor = 0.3 * slowdown;
+    const float fade_factor = 0.3 * slowdown;
+
+    int died = 0;
     for (int i = start; i < end; ++i)
     {
-        if (ps[i].life <= 0)
-            continue;
-
-    //    printf("%d\n", i);
-        ps[i].update(time);
-
-        if (ps[i].life <= 0)
-            --particles_alive;
-
-        for (int j = 0; j < 4; j++) // maybe use memcpy?
-        {
-            color[4 * i + j] = ps[i].color[j];
-            dark_color[4 * i + j] = ps[i].color[j] * 0.5;
-        }
-
-     //   printf("center %d gets %f", 2 * i, ps[i].pos[0]);
-        center[2 * i] = ps[i].pos[0];
-        center[2 * i + 1] = ps[i].pos[1];
-
-        radius[i] = ps[i].radius;
+        /* 1 for particles which are alive, 0 otherwise */
+        const float old_life = life[i];
+        const float alive = old_life > 0 ? 1.0f : 0.0f;
+        const float new_life = old_life - alive * fade[i] * fade_factor;
+        const int dies = (old_life > 0) & (new_life <= 0);
+
+        const float x = pos_x[i] + alive * speed_x[i] * speed_factor;
+        const float y = pos_y[i] + alive * speed_y[i] * speed_factor;
+        const float gx = g_x[i];
+        speed_x[i] += alive * gx * g_factor;
+        speed_y[i] += alive * g_y[i] * g_factor;
+
+        const float new_g_x = start_x[i] < x ? -1.0f : 1.0f;
+        g_x[i] = alive * new_g_x + (1 - alive) * gx;
+
+        /* alpha is proportional to the remaining life */
+        const float safe_life = old_life > 0 ? old_life : 1.0f;
+        alpha[i] *= alive * new_life / safe_life + (1 - alive);
+        radius[i] = alive * base_radius[i] * std::sqrt(std::max(new_life, 0.0f)) +
+            (1 - alive) * radius[i];
+
+        /* Dead particles are moved outside */
+        pos_x[i] = dies * -10000.0f + (1 - dies) * x;
+        pos_y[i] = dies * -10000.0f + (1 - dies) * y;
+        life[i] = new_life;
+        died += dies;
     }
+
+    return died;
 }
 
-void ParticleSystem::exec_worker_threads(std::function<void(int, int)> spawn_worker)
+void ParticleSystem::update_worker(float time, int start, int end)
 {
-//    return spawn_worker(0, ps.size());
-
-    const int num_threads = std::thread::hardware_concurrency();
-    const int worker_load = (ps.size() + num_threads - 1) / num_threads;
-
-    std::thread workers[num_threads];
-    for (int i = 0; i < num_threads; i++)
+    end = std::min(end, num_particles);
+    int died = update_kernel(start, end, life.data(), fade.data(),
+        base_radius.data(), pos_x.data(), pos_y.data(), speed_x.data(),
+        speed_y.data(), g_x.data(), g_y.data(), start_x.data(), alpha.data(),
+        radius.data());
+
+    /* Copy to the interleaved arrays for the GPU */
+    float *__restrict center = this->center.data();
+    float *__restrict color = this->color.data();
+    float *__restrict dark_color = this->dark_color.data();
+    for (int i = start; i < end; ++i)
     {
-        int thread_start = i * worker_load;
-        int thread_end = (i + 1) * worker_load;
-        thread_end = std::min(thread_end, (int)ps.size());
+        center[2 * i] = pos_x[i];
+        center[2 * i + 1] = pos_y[i];
+    }
 
-        workers[i] = std::thread([=] () { spawn_worker(thread_start, thread_end); });
+    for (int i = start; i < end; ++i)
+    {
+        color[4 * i + 3] = alpha[i];
+        dark_color[4 * i + 3] = alpha[i] * 0.5f;
     }
 
-    for (auto& w : workers)
-        w.join();
+    particles_alive -= died;
 }
 
 void ParticleSystem::update()
@@ -148,9 +198,9 @@ void ParticleSystem::update()
     float time = (wf::get_current_time() - last_update_msec) / 16.0;
     last_update_msec = wf::get_current_time();
 
-    exec_worker_threads([=] (int start, int end) {
+    wf::get_thread_pool().parallel_for(0, num_particles, [=] (size_t start, size_t end) {
         update_worker(time, start, end);
-    });
+    }, PARTICLES_PER_TASK);
 }
 
 int ParticleSystem::statistic()
@@ -198,13 +248,13 @@ void ParticleSystem::render(glm::mat4 matrix)
     program.uniform1f("smoothing", 0.7);
 
     // TODO: optimize shaders for this case
-    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, ps.size()));
+    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, num_particles));
 
     // particle color
     program.attrib_pointer("color", 4, 0, color.data());
     GL_CALL(glBlendFunc(GL_SRC_ALPHA, GL_ONE));
     program.uniform1f("smoothing", 0.5);
-    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, ps.size()));
+    GL_CALL(glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, 4, num_particles));
 
     GL_CALL(glDisable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
@@ -6,6 +6,8 @@
 #include <atomic>
 #include <vector>
 
+/* The initial state of a particle. The particle system itself stores the
+ * particles as a structure of arrays. */
 struct Particle
 {
     float life = -1;
@@ -17,14 +19,9 @@ struct Particle
     glm::vec2 start_pos;
 
     glm::vec4 color{1.0, 1.0, 1.0, 1.0};
-
-    /* update the given particle
-     * time is the percentage of the frame which has elapsed
-     * must be thread-safe */
-    void update(float time);
 };
 
-/* a function to initialize a particle */
+/* a function to initialize a particle, must be thread-safe */
 using ParticleIniter = std::function<void(Particle&)>;
 
 class ParticleSystem
@@ -65,8 +62,15 @@ class ParticleSystem
         uint32_t last_update_msec;
 
         std::atomic<int> particles_alive;
-        std::vector<Particle> ps;
+        int num_particles = 0;
+
+        /* The particle state, stored as a structure of arrays, so that the
+         * update kernel can be vectorized by the compiler */
+        std::vector<float> life, fade, base_radius;
+        std::vector<float> pos_x, pos_y, speed_x, speed_y;
+        std::vector<float> g_x, g_y, start_x, alpha;
 
+        /* Per-instance data for the GPU, written directly by the kernel */
         static constexpr int color_per_particle = 4;
         std::vector<float> color, dark_color;
 
@@ -77,7 +81,7 @@ class ParticleSystem
         std::vector<float> center;
 
         OpenGL::program_t program;
-        void exec_worker_threads(std::function<void(int, int)> spawn_worker);
+        void spawn_at(int i);
         void update_worker(float time, int start, int end);
         void create_program();
 };
@@ -51,6 +51,20 @@ wf_blur_base::wf_blur_base(wf::output_t *output,
     this->offset_opt.set_callback(options_changed);
     this->degrade_opt.set_callback(options_changed);
     this->iterations_opt.set_callback(options_changed);
+    this->fb[0].owner = this->fb[1].owner = "blur";
+
+    for (int i = 0; i < 2; i++)
+    {
+        handles[i].position = program[i].get_attrib("position");
+        handles[i].offset = program[i].get_uniform("offset");
+        handles[i].halfpixel = program[i].get_uniform("halfpixel");
+        handles[i].size = program[i].get_uniform("size");
+        handles[i].iterations = program[i].get_uniform("iterations");
+    }
+
+    blend_handles.position = blend_program.get_attrib("position");
+    blend_handles.mvp = blend_program.get_uniform("mvp");
+    blend_handles.bg_texture = blend_program.get_uniform("bg_texture");
 
     OpenGL::render_begin();
     blend_program.compile(blur_blend_vertex_shader, blur_blend_fragment_shader);
@@ -211,12 +225,13 @@ void wf_blur_base::render(wf::texture_t src_tex, wlr_box src_box,
         -1.0f,  1.0f
     };
 
-    blend_program.attrib_pointer("position", 2, 0, vertexData);
+    blend_program.attrib_pointer(blend_handles.position, 2, 0, vertexData);
 
     /* Blend blurred background with window texture src_tex */
-    blend_program.uniformMatrix4f("mvp", glm::inverse(target_fb.transform));
+    blend_program.uniformMatrix4f(blend_handles.mvp,
+        glm::inverse(target_fb.transform));
     /* XXX: core should give us the number of texture units used */
-    blend_program.uniform1i("bg_texture", 1);
+    blend_program.uniform1i(blend_handles.bg_texture, 1);
 
     blend_program.set_active_texture(src_tex);
     GL_CALL(glActiveTexture(GL_TEXTURE0 + 1));
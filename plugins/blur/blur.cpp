@@ -156,6 +156,7 @@ class wayfire_blur : public wf::plugin_interface_t
     {
         grab_interface->name = "blur";
         grab_interface->capabilities = 0;
+        saved_pixels.owner = "blur";
 
         blur_method_changed = [=] () {
             blur_algorithm = create_blur_from_name(output, method_opt);
@@ -102,6 +102,21 @@ class wf_blur_base
      * view texture */
     OpenGL::program_t blend_program;
 
+    /* Handles of the uniforms and attributes used by the algorithm programs.
+     * They are registered in the base constructor and stay valid when the
+     * algorithm compiles its programs. */
+    struct
+    {
+        OpenGL::attrib_t position;
+        OpenGL::uniform_t offset, halfpixel, size, iterations;
+    } handles[2];
+
+    struct
+    {
+        OpenGL::attrib_t position;
+        OpenGL::uniform_t mvp, bg_texture;
+    } blend_handles;
+
     /* used to get individual algorithm options from config
      * should be set by the constructor */
     std::string algorithm_name;
@@ -88,11 +88,11 @@ class wf_bokeh_blur : public wf_blur_base
         OpenGL::render_begin();
         /* Upload data to shader */
         program[0].use(wf::TEXTURE_TYPE_RGBA);
-        program[0].uniform2f("halfpixel", 0.5f / width, 0.5f / height);
-        program[0].uniform1f("offset", offset);
-        program[0].uniform1i("iterations", iterations);
+        program[0].uniform2f(handles[0].halfpixel, 0.5f / width, 0.5f / height);
+        program[0].uniform1f(handles[0].offset, offset);
+        program[0].uniform1i(handles[0].iterations, iterations);
 
-        program[0].attrib_pointer("position", 2, 0, vertexData);
+        program[0].attrib_pointer(handles[0].position, 2, 0, vertexData);
         GL_CALL(glDisable(GL_BLEND));
         render_iteration(blur_region, fb[0], fb[1], width, height);
 
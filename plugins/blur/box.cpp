@@ -107,9 +107,9 @@ class wf_box_blur : public wf_blur_base
         };
 
         program[i].use(wf::TEXTURE_TYPE_RGBA);
-        program[i].uniform2f("size", width, height);
-        program[i].uniform1f("offset", offset);
-        program[i].attrib_pointer("position", 2, 0, vertexData);
+        program[i].uniform2f(handles[i].size, width, height);
+        program[i].uniform1f(handles[i].offset, offset);
+        program[i].attrib_pointer(handles[i].position, 2, 0, vertexData);
     }
 
     void blur(const wf::region_t& blur_region, int i, int width, int height)
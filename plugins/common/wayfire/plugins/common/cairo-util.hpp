@@ -31,4 +31,6 @@ static void cairo_surface_upload_to_texture(
     GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
     GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
             buffer.width, buffer.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, src));
+    OpenGL::register_texture_memory(buffer.tex,
+        4ull * buffer.width * buffer.height, buffer.owner);
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <wayfire/opengl.hpp>
 #include <wayfire/nonstd/noncopyable.hpp>
+#include <string>
 
 namespace wf
 {
@@ -10,6 +11,9 @@ struct simple_texture_t : public noncopyable_t
     int width = 0;
     int height = 0;
 
+    /** The name under which the GPU memory of the texture is accounted */
+    std::string owner = "simple-texture";
+
     /**
      * Destroy the GL texture.
      * This will call OpenGL::render_begin()/end() internally.
@@ -21,6 +25,7 @@ struct simple_texture_t : public noncopyable_t
 
         OpenGL::render_begin();
         GL_CALL(glDeleteTextures(1, &tex));
+        OpenGL::unregister_texture_memory(tex);
         OpenGL::render_end();
         this->tex = -1;
     }
@@ -47,6 +47,11 @@ class wayfire_cube : public wf::plugin_interface_t
     float identity_z_offset;
 
     OpenGL::program_t program;
+    struct
+    {
+        OpenGL::attrib_t position, uv_position;
+        OpenGL::uniform_t vp, model, deform, light, ease;
+    } handles;
 
     wf_cube_animation_attribs animation;
     wf::option_wrapper_t<bool> use_light{"cube/light"};
@@ -194,6 +199,14 @@ class wayfire_cube : public wf::plugin_interface_t
 #endif
         }
 
+        handles.position = program.get_attrib("position");
+        handles.uv_position = program.get_attrib("uvPosition");
+        handles.vp = program.get_uniform("VP");
+        handles.model = program.get_uniform("model");
+        handles.deform = program.get_uniform("deform");
+        handles.light = program.get_uniform("light");
+        handles.ease = program.get_uniform("ease");
+
         auto wsize = output->workspace->get_workspace_grid_size();
         streams.resize(wsize.width);
         animation.projection = glm::perspective(45.0f, 1.f, 0.1f, 100.f);
@@ -385,18 +398,64 @@ class wayfire_cube : public wf::plugin_interface_t
         animation.view = zoom_translate * rotation * view;
     }
 
-    void update_workspace_streams()
+    /**
+     * Get the scale at which the given side of the cube is displayed, relative
+     * to the size of the output. Because of the perspective, the parts of a
+     * side which are closer to the camera are displayed larger than the rest,
+     * so the longest edge of the projected side is used.
+     */
+    float get_side_scale(int i, const glm::mat4& vp, const glm::mat4& fb_transform)
     {
+        static const glm::vec4 corners[] = {
+            {-0.5, 0.5, 0, 1}, {0.5, 0.5, 0, 1},
+            {0.5, -0.5, 0, 1}, {-0.5, -0.5, 0, 1},
+        };
+
+        auto mvp = vp * calculate_model_matrix(i, fb_transform);
+        glm::vec2 projected[4];
+        for (int j = 0; j < 4; j++)
+        {
+            auto p = mvp * corners[j];
+            /* The side is (partially) behind the camera */
+            if (p.w <= 0)
+                return 1.0;
+
+            projected[j] = glm::vec2(p) / p.w;
+        }
+
+        /* The output spans 2 units in normalized device coordinates */
+        float scale = 0;
+        for (int j = 0; j < 4; j++)
+        {
+            scale = std::max(scale,
+                glm::length(projected[(j + 1) % 4] - projected[j]) / 2);
+        }
+
+        return scale;
+    }
+
+    void update_workspace_streams(const wf::framebuffer_t& dest)
+    {
+        /* Sides which are displayed smaller than the output, for ex. when
+         * zoomed out, don't need to be rendered at full resolution */
+        auto vp = calculate_vp_matrix(dest);
+
         auto cws = output->workspace->get_current_workspace();
         for(size_t i = 0; i < streams.size(); i++)
         {
+            /* The side on which the stream is rendered, see render_cube() */
+            int side = (i + streams.size() - cws.x) % streams.size();
+            float scale = get_side_scale(side, vp, dest.transform);
+
             if (!streams[i].running)
             {
                 streams[i].ws = {(int)i, cws.y};
-                output->render->workspace_stream_start(streams[i]);
+                output->render->workspace_stream_start(streams[i],
+                    scale, scale);
             } else
             {
-                output->render->workspace_stream_update(streams[i]);
+                output->render->workspace_stream_update(streams[i],
+                    scale, scale);
             }
         }
     }
@@ -434,7 +493,7 @@ class wayfire_cube : public wf::plugin_interface_t
             GL_CALL(glBindTexture(GL_TEXTURE_2D, streams[index].buffer.tex));
 
             auto model = calculate_model_matrix(i, fb_transform);
-            program.uniformMatrix4f("model", model);
+            program.uniformMatrix4f(handles.model, model);
 
             if (tessellation_support) {
 #ifdef USE_GLES32
@@ -448,7 +507,7 @@ class wayfire_cube : public wf::plugin_interface_t
 
     void render(const wf::framebuffer_t& dest)
     {
-        update_workspace_streams();
+        update_workspace_streams(dest);
         if (program.get_program_id(wf::TEXTURE_TYPE_RGBA) == 0)
             load_program();
 
@@ -480,14 +539,14 @@ class wayfire_cube : public wf::plugin_interface_t
             0.0f, 0.0f
         };
 
-        program.attrib_pointer("position", 2, 0, vertexData);
-        program.attrib_pointer("uvPosition", 2, 0, coordData);
-        program.uniformMatrix4f("VP", vp);
+        program.attrib_pointer(handles.position, 2, 0, vertexData);
+        program.attrib_pointer(handles.uv_position, 2, 0, coordData);
+        program.uniformMatrix4f(handles.vp, vp);
         if (tessellation_support)
         {
-            program.uniform1i("deform", use_deform);
-            program.uniform1i("light", use_light);
-            program.uniform1f("ease",
+            program.uniform1i(handles.deform, use_deform);
+            program.uniform1i(handles.light, use_light);
+            program.uniform1f(handles.ease,
                 animation.cube_animation.ease_deformation);
         }
 
@@ -0,0 +1,103 @@
+#include "deco-atlas.hpp"
+#include "deco-theme.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace wf
+{
+namespace decor
+{
+button_atlas_t::~button_atlas_t()
+{
+    if (tex == (GLuint)-1)
+        return;
+
+    OpenGL::render_begin();
+    GL_CALL(glDeleteTextures(1, &tex));
+    OpenGL::unregister_texture_memory(tex);
+    OpenGL::render_end();
+}
+
+void button_atlas_t::allocate()
+{
+    const int cells = NUM_BUTTON_TYPES * HOVER_LEVELS;
+    const int rows = (cells + COLUMNS - 1) / COLUMNS;
+    width = COLUMNS * (CELL_WIDTH + 2 * PADDING);
+    height = rows * (CELL_HEIGHT + 2 * PADDING);
+    rasterized.assign(cells, false);
+
+    /* Start with a transparent atlas, which takes care of the padding */
+    std::vector<uint32_t> clear(width * height, 0);
+    GL_CALL(glGenTextures(1, &tex));
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+    GL_CALL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
+        GL_RGBA, GL_UNSIGNED_BYTE, clear.data()));
+    OpenGL::register_texture_memory(tex, 4ull * width * height,
+        "decoration-atlas");
+}
+
+button_atlas_t::region_t button_atlas_t::get_button(
+    const decoration_theme_t& theme, button_type_t type, double hover_progress)
+{
+    if (tex == (GLuint)-1)
+        allocate();
+
+    /* Map [-1, 1] to the hover levels */
+    int level = std::round((hover_progress + 1) / 2 * (HOVER_LEVELS - 1));
+    level = std::max(0, std::min(HOVER_LEVELS - 1, level));
+
+    int cell = type * HOVER_LEVELS + level;
+    int x = (cell % COLUMNS) * (CELL_WIDTH + 2 * PADDING) + PADDING;
+    int y = (cell / COLUMNS) * (CELL_HEIGHT + 2 * PADDING) + PADDING;
+
+    if (!rasterized[cell])
+    {
+        decoration_theme_t::button_state_t state = {
+            .width = CELL_WIDTH,
+            .height = CELL_HEIGHT,
+            .border = CELL_BORDER,
+            .hover_progress = (2.0 * level / (HOVER_LEVELS - 1)) - 1,
+        };
+
+        auto surface = theme.get_button_surface(type, state);
+        cairo_surface_flush(surface);
+
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+        GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH,
+            cairo_image_surface_get_stride(surface) / 4));
+        GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y,
+            CELL_WIDTH, CELL_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE,
+            cairo_image_surface_get_data(surface)));
+        GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+        cairo_surface_destroy(surface);
+
+        rasterized[cell] = true;
+    }
+
+    region_t region;
+    region.tex = tex;
+    region.texg.x1 = 1.0f * x / width;
+    region.texg.x2 = 1.0f * (x + CELL_WIDTH) / width;
+    /* With TEXTURE_TRANSFORM_INVERT_Y, y2 is sampled at the top */
+    region.texg.y1 = 1.0f * (y + CELL_HEIGHT) / height;
+    region.texg.y2 = 1.0f * y / height;
+    return region;
+}
+
+std::shared_ptr<button_atlas_t> button_atlas_t::get_shared()
+{
+    static std::weak_ptr<button_atlas_t> shared;
+
+    auto atlas = shared.lock();
+    if (!atlas)
+    {
+        atlas = std::make_shared<button_atlas_t>();
+        shared = atlas;
+    }
+
+    return atlas;
+}
+}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <wayfire/opengl.hpp>
+#include <wayfire/nonstd/noncopyable.hpp>
+#include "deco-button.hpp"
+
+namespace wf
+{
+namespace decor
+{
+class decoration_theme_t;
+
+/**
+ * A texture atlas containing the button icons in all their states, shared by
+ * all decorations.
+ *
+ * The hover progress of the buttons is quantized, and each combination of
+ * button type and hover progress has its own cell in the atlas. Cells are
+ * rasterized the first time they are needed, and only the new cell is
+ * uploaded.
+ */
+class button_atlas_t : public noncopyable_t
+{
+  public:
+    /** The size of a button cell, in pixels */
+    static constexpr int CELL_WIDTH = 25 * 4;
+    static constexpr int CELL_HEIGHT = 16 * 4;
+    static constexpr int CELL_BORDER = 1 * 4;
+
+    /** A button icon in the atlas */
+    struct region_t
+    {
+        /** The atlas texture */
+        GLuint tex;
+        /**
+         * The texture coordinates of the icon, to be used with
+         * TEXTURE_USE_TEX_GEOMETRY and TEXTURE_TRANSFORM_INVERT_Y.
+         */
+        gl_geometry texg;
+    };
+
+    /**
+     * Get the icon for the given button state, rasterizing it if necessary.
+     * Requires a bound GL context.
+     *
+     * @param theme The theme used to rasterize the icon.
+     * @param type The button type.
+     * @param hover_progress The hover progress of the button, in [-1, 1].
+     */
+    region_t get_button(const decoration_theme_t& theme, button_type_t type,
+        double hover_progress);
+
+    /**
+     * Get the atlas, which is shared by all holders of the returned pointer
+     * and destroyed together with its texture when the last one is gone.
+     */
+    static std::shared_ptr<button_atlas_t> get_shared();
+
+    button_atlas_t() = default;
+    ~button_atlas_t();
+
+  private:
+    static constexpr int NUM_BUTTON_TYPES = BUTTON_MINIMIZE + 1;
+    static constexpr int HOVER_LEVELS = 21;
+    static constexpr int COLUMNS = 8;
+    /* Transparent space around each cell, so that linear filtering doesn't
+     * sample the neighbouring cells */
+    static constexpr int PADDING = 2;
+
+    GLuint tex = -1;
+    int width, height;
+    std::vector<bool> rasterized;
+
+    void allocate();
+};
+}
+}
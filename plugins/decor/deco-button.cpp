@@ -1,7 +1,6 @@
 #include "deco-button.hpp"
 #include "deco-theme.hpp"
 #include <wayfire/opengl.hpp>
-#include <wayfire/plugins/common/cairo-util.hpp>
 
 #define HOVERED  1.0
 #define NORMAL   0.0
@@ -20,7 +19,6 @@ void button_t::set_button_type(button_type_t type)
 {
     this->type = type;
     this->hover.animate(0, 0);
-    update_texture();
     add_idle_damage();
 }
 
@@ -64,41 +62,24 @@ void button_t::render(const wf::framebuffer_t& fb, wf::geometry_t geometry,
 {
     OpenGL::render_begin(fb);
     fb.logic_scissor(scissor);
-    OpenGL::render_texture(button_texture.tex, fb, geometry, {1, 1, 1, 1},
-        OpenGL::TEXTURE_TRANSFORM_INVERT_Y);
+    auto icon = theme.get_button_texture(type, hover);
+    gl_geometry target = {
+        1.0f * geometry.x, 1.0f * geometry.y,
+        1.0f * geometry.x + geometry.width, 1.0f * geometry.y + geometry.height,
+    };
+    OpenGL::render_transformed_texture(icon.tex, target, icon.texg,
+        fb.get_orthographic_projection(), {1, 1, 1, 1},
+        OpenGL::TEXTURE_TRANSFORM_INVERT_Y | OpenGL::TEXTURE_USE_TEX_GEOMETRY);
     OpenGL::render_end();
 
     if (this->hover.running())
         add_idle_damage();
 }
 
-void button_t::update_texture()
-{
-    /* We render a big predefined resolution here */
-    const int WIDTH = 25;
-    const int HEIGHT = 16;
-    const int BORDER = 1;
-    const int SCALE = 4;
-
-    decoration_theme_t::button_state_t state = {
-        .width = WIDTH * SCALE,
-        .height = HEIGHT * SCALE,
-        .border = BORDER * SCALE,
-        .hover_progress = hover,
-    };
-
-    auto surface = theme.get_button_surface(type, state);
-    OpenGL::render_begin();
-    cairo_surface_upload_to_texture(surface, this->button_texture);
-    OpenGL::render_end();
-    cairo_surface_destroy(surface);
-}
-
 void button_t::add_idle_damage()
 {
     this->idle_damage.run_once([=] () {
         this->damage_callback();
-        update_texture();
     });
 }
 
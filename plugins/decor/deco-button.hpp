@@ -7,7 +7,6 @@
 #include <wayfire/render-manager.hpp>
 #include <wayfire/nonstd/noncopyable.hpp>
 #include <wayfire/util/duration.hpp>
-#include <wayfire/plugins/common/simple-texture.hpp>
 
 #include <cairo.h>
 
@@ -73,7 +72,6 @@ class button_t : public noncopyable_t
 
     /* Whether the button needs repaint */
     button_type_t type;
-    wf::simple_texture_t button_texture;
 
     /* Whether the button is currently being hovered */
     bool is_hovered = false;
@@ -86,11 +84,6 @@ class button_t : public noncopyable_t
     wf::wl_idle_call idle_damage;
     /** Damage button the next time the main loop goes idle */
     void add_idle_damage();
-
-    /**
-     * Redraw the button surface and store it as a texture
-     */
-    void update_texture();
 };
 }
 }
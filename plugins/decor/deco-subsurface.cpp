@@ -28,6 +28,54 @@ extern "C"
 #undef static
 }
 
+/**
+ * Upload only the columns of the new title which differ from the old one.
+ * Titles usually change only in a part of the text, for ex. the current
+ * directory in a terminal, so this is typically a small part of the texture.
+ *
+ * @param old_surface The surface currently uploaded to the texture.
+ * @param new_surface The new surface, with the same size as the old one.
+ * @param tex The texture to update.
+ */
+static void upload_changed_columns(cairo_surface_t *old_surface,
+    cairo_surface_t *new_surface, wf::simple_texture_t& tex)
+{
+    const int width  = cairo_image_surface_get_width(new_surface);
+    const int height = cairo_image_surface_get_height(new_surface);
+    const int stride = cairo_image_surface_get_stride(new_surface);
+    auto old_data = cairo_image_surface_get_data(old_surface);
+    auto new_data = cairo_image_surface_get_data(new_surface);
+
+    /* Find the leftmost and rightmost differing columns over all rows */
+    int first = width, last = -1;
+    for (int y = 0; y < height; y++)
+    {
+        auto old_row = (const uint32_t*)(old_data + y * stride);
+        auto new_row = (const uint32_t*)(new_data + y * stride);
+
+        int x = 0;
+        while (x < first && old_row[x] == new_row[x])
+            ++x;
+        first = x;
+
+        x = width - 1;
+        while (x > last && old_row[x] == new_row[x])
+            --x;
+        last = x;
+    }
+
+    if (first > last)
+        return;
+
+    GL_CALL(glBindTexture(GL_TEXTURE_2D, tex.tex));
+    GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, stride / 4));
+    GL_CALL(glPixelStorei(GL_UNPACK_SKIP_PIXELS, first));
+    GL_CALL(glTexSubImage2D(GL_TEXTURE_2D, 0, first, 0, last - first + 1, height,
+        GL_RGBA, GL_UNSIGNED_BYTE, new_data));
+    GL_CALL(glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0));
+    GL_CALL(glPixelStorei(GL_UNPACK_ROW_LENGTH, 0));
+}
+
 class simple_decoration_surface : public wf::surface_interface_t,
     public wf::compositor_surface_t, public wf::decorator_frame_t_t
 {
@@ -47,15 +95,28 @@ class simple_decoration_surface : public wf::surface_interface_t,
         int target_width = width * scale;
         int target_height = height * scale;
 
-        if (title_texture.tex.width != target_width ||
-            title_texture.tex.height != target_height ||
-            title_texture.current_text != view->get_title())
+        if (title_texture.tex.width == target_width &&
+            title_texture.tex.height == target_height &&
+            title_texture.current_text == view->get_title())
         {
-            auto surface = theme.render_text(view->get_title(),
-                target_width, target_height);
-            cairo_surface_upload_to_texture(surface, title_texture.tex);
-            title_texture.current_text = view->get_title();
+            return;
         }
+
+        auto surface = theme.get_title_surface(view->get_title(),
+            target_width, target_height);
+        if (title_texture.surface &&
+            title_texture.tex.width == target_width &&
+            title_texture.tex.height == target_height)
+        {
+            upload_changed_columns(title_texture.surface.get(), surface.get(),
+                title_texture.tex);
+        } else
+        {
+            cairo_surface_upload_to_texture(surface.get(), title_texture.tex);
+        }
+
+        title_texture.surface = surface;
+        title_texture.current_text = view->get_title();
     }
 
     int width = 100, height = 100;
@@ -65,6 +126,8 @@ class simple_decoration_surface : public wf::surface_interface_t,
     struct {
         wf::simple_texture_t tex;
         std::string current_text = "";
+        /* The surface currently in tex, shared with the title cache */
+        std::shared_ptr<cairo_surface_t> surface;
     } title_texture;
 
     wf::decor::decoration_theme_t theme;
@@ -77,6 +140,7 @@ class simple_decoration_surface : public wf::surface_interface_t,
         layout{theme, [=] (wlr_box box) {this->damage_surface_box(box); }}
     {
         this->view = view;
+        this->title_texture.tex.owner = "decoration";
         view->connect_signal("title-changed", &title_set);
 
         // make sure to hide frame if the view is fullscreen
@@ -2,7 +2,9 @@
 #include <wayfire/core.hpp>
 #include <wayfire/opengl.hpp>
 #include <config.h>
+#include <list>
 #include <map>
+#include <unordered_map>
 
 extern "C"
 {
@@ -80,6 +82,62 @@ cairo_surface_t *decoration_theme_t::render_text(std::string text,
     return surface;
 }
 
+/**
+ * A cache of the most recently rendered titles, so that decorations with the
+ * same title and size, for ex. several terminals, render it only once.
+ */
+static struct title_cache_t : public noncopyable_t
+{
+    /* The maximal number of titles to keep around */
+    static constexpr size_t max_entries = 64;
+
+    using entry_t = std::pair<std::string, std::shared_ptr<cairo_surface_t>>;
+    /* Most recently used first */
+    std::list<entry_t> entries;
+    std::unordered_map<std::string, std::list<entry_t>::iterator> index;
+
+    std::shared_ptr<cairo_surface_t> find(const std::string& key)
+    {
+        auto it = index.find(key);
+        if (it == index.end())
+            return nullptr;
+
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->second;
+    }
+
+    void insert(const std::string& key,
+        std::shared_ptr<cairo_surface_t> surface)
+    {
+        entries.emplace_front(key, std::move(surface));
+        index[key] = entries.begin();
+
+        if (entries.size() > max_entries)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+} title_cache;
+
+std::shared_ptr<cairo_surface_t> decoration_theme_t::get_title_surface(
+    const std::string& text, int width, int height) const
+{
+    auto key = (std::string)font + '\0' + std::to_string(width) + 'x' +
+        std::to_string(height) + '\0' + text;
+
+    auto surface = title_cache.find(key);
+    if (!surface)
+    {
+        surface = std::shared_ptr<cairo_surface_t>(
+            render_text(text, width, height), cairo_surface_destroy);
+        cairo_surface_flush(surface.get());
+        title_cache.insert(key, surface);
+    }
+
+    return surface;
+}
+
 static struct icon_cache_t : public noncopyable_t
 {
     ~icon_cache_t()
@@ -163,5 +221,11 @@ cairo_surface_t *decoration_theme_t::get_button_surface(button_type_t button,
     return button_surface;
 }
 
+button_atlas_t::region_t decoration_theme_t::get_button_texture(
+    button_type_t button, double hover_progress) const
+{
+    return atlas->get_button(*this, button, hover_progress);
+}
+
 }
 }
@@ -1,6 +1,7 @@
 #pragma once
 #include <wayfire/render-manager.hpp>
 #include "deco-button.hpp"
+#include "deco-atlas.hpp"
 
 namespace wf
 {
@@ -38,6 +39,13 @@ class decoration_theme_t
      */
     cairo_surface_t *render_text(std::string text, int width, int height) const;
 
+    /**
+     * Get the rendered title with the given size. Titles are cached and
+     * shared by all decorations, so the returned surface must not be modified.
+     */
+    std::shared_ptr<cairo_surface_t> get_title_surface(const std::string& text,
+        int width, int height) const;
+
     struct button_state_t
     {
         /** Button width */
@@ -61,7 +69,19 @@ class decoration_theme_t
     cairo_surface_t *get_button_surface(button_type_t button,
         const button_state_t& state) const;
 
+    /**
+     * Get the icon for the given button from the atlas shared by all
+     * decorations. Requires a bound GL context.
+     *
+     * @param button The button type.
+     * @param hover_progress The progress of button hover, in range [-1, 1].
+     */
+    button_atlas_t::region_t get_button_texture(button_type_t button,
+        double hover_progress) const;
+
   private:
+    std::shared_ptr<button_atlas_t> atlas = button_atlas_t::get_shared();
+
     wf::option_wrapper_t<std::string> font{"decoration/font"};
     wf::option_wrapper_t<int> title_height{"decoration/title_height"};
     wf::option_wrapper_t<int> border_size{"decoration/border_size"};
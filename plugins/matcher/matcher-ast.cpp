@@ -63,30 +63,68 @@ namespace wf
 
         namespace matchers
         {
-            using func_t = std::function<bool(string, string)>;
-            func_t exact = [] (string text, string pattern)
+            /* A matcher, compiled from its pattern when the expression is
+             * parsed */
+            struct matcher_t
             {
-                if (pattern == "any")
-                    return true;
-
-                bool result = false;
-                try {
-                    result = std::regex_match(text, std::regex(pattern));
-                } catch (const std::exception& e) {
-                    LOGE ("Invalid regular expression: %s", pattern.c_str());
+                virtual bool matches(const string& text) = 0;
+                virtual ~matcher_t() = default;
+            };
+
+            struct exact_t : public matcher_t
+            {
+                bool match_any = false;
+                bool valid = true;
+                std::regex regex;
+
+                exact_t(const string& pattern)
+                {
+                    if (pattern == "any")
+                    {
+                        match_any = true;
+                        return;
+                    }
+
+                    try {
+                        regex = std::regex(pattern, std::regex::optimize);
+                    } catch (const std::exception& e) {
+                        LOGE ("Invalid regular expression: %s", pattern.c_str());
+                        valid = false;
+                    }
                 }
 
-                return result;
+                bool matches(const string& text) override
+                {
+                    if (match_any)
+                        return true;
+
+                    return valid && std::regex_match(text, regex);
+                }
             };
 
-            func_t contains = [] (string text, string pattern)
+            struct contains_t : public matcher_t
             {
-                return text.find(pattern) != text.npos;
+                string pattern;
+                contains_t(const string& pattern) : pattern(pattern) {}
+
+                bool matches(const string& text) override
+                {
+                    return text.find(pattern) != text.npos;
+                }
             };
 
-            std::map<string, func_t> matchers = {
-                {"is", exact},
-                {"contains", contains},
+            using create_func_t =
+                std::function<std::unique_ptr<matcher_t>(const string&)>;
+
+            template<class matcher_type>
+            std::unique_ptr<matcher_t> create(const string& pattern)
+            {
+                return std::make_unique<matcher_type> (pattern);
+            }
+
+            std::map<string, create_func_t> matchers = {
+                {"is", create<exact_t>},
+                {"contains", create<contains_t>},
             };
         }
 
@@ -110,8 +148,7 @@ namespace wf
         struct single_expression_t : public expression_t
         {
             match_field field;
-            matchers::func_t matcher;
-            string matcher_arg;
+            std::unique_ptr<matchers::matcher_t> matcher;
 
             single_expression_t(string expr)
             {
@@ -128,29 +165,46 @@ namespace wf
                     throw std::invalid_argument("Invalid match mode: " + tokens[1]);
 
                 this->field = match_fields[tokens[0]];
-                this->matcher = matchers::matchers[tokens[1]];
-                this->matcher_arg = tokens[2];
+                this->matcher = matchers::matchers[tokens[1]](tokens[2]);
+            }
+
+            const string& get_field(const view_t& view)
+            {
+                switch (this->field)
+                {
+                    case FIELD_TITLE:
+                        return view.title;
+                    case FIELD_APP_ID:
+                        return view.app_id;
+                    case FIELD_TYPE:
+                        return view.type;
+                    case FIELD_FOCUSEABLE:
+                        return view.focuseable;
+                }
+
+                return view.title;
             }
 
             bool evaluate(const view_t& view) override
             {
-                string view_field_data;
+                return this->matcher->matches(get_field(view));
+            }
+
+            uint32_t get_used_fields() override
+            {
                 switch (this->field)
                 {
                     case FIELD_TITLE:
-                        view_field_data = view.title;
-                        break;
+                        return VIEW_FIELD_TITLE;
                     case FIELD_APP_ID:
-                        view_field_data = view.app_id;
-                        break;
+                        return VIEW_FIELD_APP_ID;
                     case FIELD_TYPE:
-                        view_field_data = view.type;
-                        break;
+                        return VIEW_FIELD_TYPE;
                     case FIELD_FOCUSEABLE:
-                        view_field_data = view.focuseable;
+                        return VIEW_FIELD_FOCUSEABLE;
                 }
 
-                return this->matcher(view_field_data, this->matcher_arg);
+                return 0;
             }
         };
 
@@ -259,6 +313,12 @@ namespace wf
 
                 return false;
             }
+
+            uint32_t get_used_fields() override
+            {
+                return arg0->get_used_fields() |
+                    (arg1 ? arg1->get_used_fields() : 0);
+            }
         };
 
         struct any_expression_t : public expression_t
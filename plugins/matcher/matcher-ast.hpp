@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <utility>
+#include <cstdint>
 
 namespace wf
 {
@@ -17,10 +18,22 @@ namespace wf
             std::string focuseable;
         };
 
+        /* Bitmask of the fields of view_t */
+        enum view_field_mask_t
+        {
+            VIEW_FIELD_TYPE       = (1 << 0),
+            VIEW_FIELD_TITLE      = (1 << 1),
+            VIEW_FIELD_APP_ID     = (1 << 2),
+            VIEW_FIELD_FOCUSEABLE = (1 << 3),
+        };
+
         /* A base class for expressions */
         struct expression_t
         {
             virtual bool evaluate(const view_t& view) = 0;
+            /* Get a bitmask of the view_t fields which evaluate() uses, so that
+             * the other fields do not need to be filled in */
+            virtual uint32_t get_used_fields() { return 0; }
             virtual ~expression_t() = default;
         };
 
@@ -57,6 +57,7 @@ namespace wf
         class default_view_matcher : public view_matcher
         {
             std::unique_ptr<expression_t> expr;
+            uint32_t used_fields = 0;
             wf::option_sptr_t<std::string> match_option;
 
             wf::config::option_base_t::updated_callback_t on_match_string_updated = [=] ()
@@ -69,6 +70,7 @@ namespace wf
                 }
 
                 this->expr = std::move(result.first);
+                this->used_fields = expr ? expr->get_used_fields() : 0;
             };
 
             public:
@@ -89,11 +91,17 @@ namespace wf
                 if (!expr || !view->is_mapped())
                     return false;
 
+                /* Fill in only the fields which the expression uses, to avoid
+                 * needless string copies */
                 view_t data;
-                data.title = view->get_title();
-                data.app_id = view->get_app_id();
-                data.type = get_view_type(view);
-                data.focuseable = view->is_focuseable() ?  "true" : "false";
+                if (used_fields & VIEW_FIELD_TITLE)
+                    data.title = view->get_title();
+                if (used_fields & VIEW_FIELD_APP_ID)
+                    data.app_id = view->get_app_id();
+                if (used_fields & VIEW_FIELD_TYPE)
+                    data.type = get_view_type(view);
+                if (used_fields & VIEW_FIELD_FOCUSEABLE)
+                    data.focuseable = view->is_focuseable() ?  "true" : "false";
 
                 return expr->evaluate(data);
             }
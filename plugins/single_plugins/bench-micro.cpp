@@ -0,0 +1,326 @@
+#include "bench-micro.hpp"
+#include <wayfire/nonstd/safe-list.hpp>
+#include <wayfire/object.hpp>
+#include <wayfire/core.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/util/log.hpp>
+#include <wayfire/view.hpp>
+#include <wayfire/workspace-manager.hpp>
+#include "../matcher/matcher-ast.hpp"
+
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <regex>
+#include <time.h>
+
+namespace wf
+{
+namespace bench
+{
+namespace
+{
+int64_t get_current_nsec()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+/* Keeps the compiler from optimizing away the benchmarked code */
+volatile int64_t sink;
+
+/** Time iterations calls of op, and add the result under the given name */
+template<class Op>
+void time_op(std::vector<micro_result_t>& results, std::string name,
+    int iterations, Op op)
+{
+    int64_t start = get_current_nsec();
+    for (int i = 0; i < iterations; i++)
+        op(i);
+
+    results.push_back({name, 1.0 * (get_current_nsec() - start) / iterations});
+}
+
+/**
+ * safe_list_t as it was before it was stored in a vector: a std::list of
+ * separately allocated elements, iterated through std::function.
+ */
+template<class T>
+struct legacy_safe_list_t
+{
+    std::list<std::unique_ptr<T>> list;
+
+    void push_back(T value)
+    {
+        list.push_back(std::make_unique<T>(std::move(value)));
+    }
+
+    void for_each(std::function<void(T&)> func) const
+    {
+        auto it = list.begin();
+        for (int size = list.size(); size > 0; size--, it++)
+        {
+            if (*it)
+                func(**it);
+        }
+    }
+
+    void remove_all(const T& value)
+    {
+        for (auto& it : list)
+        {
+            if (it && *it == value)
+                it = nullptr;
+        }
+
+        /* Stands for the idle cleanup */
+        list.remove(nullptr);
+    }
+};
+
+/** Iterate over and insert/remove elements in a list with the given size */
+template<class List>
+void bench_list(std::vector<micro_result_t>& results, std::string prefix,
+    int iterations, int size)
+{
+    List list;
+    for (int i = 0; i < size; i++)
+        list.push_back(i);
+
+    time_op(results, prefix + "-iterate-" + std::to_string(size), iterations,
+        [&] (int)
+    {
+        int64_t sum = 0;
+        list.for_each([&] (int& el) { sum += el; });
+        sink = sum;
+    });
+
+    time_op(results, prefix + "-insert-remove-" + std::to_string(size),
+        iterations, [&] (int i)
+    {
+        list.push_back(size + i);
+        list.remove_all(size + i);
+    });
+}
+
+std::vector<micro_result_t> bench_safe_list(wf::output_t*, int iterations)
+{
+    std::vector<micro_result_t> results;
+    for (int size : {8, 64, 512})
+    {
+        bench_list<wf::safe_list_t<int>>(results, "safe-list",
+            iterations, size);
+        bench_list<legacy_safe_list_t<int>>(results, "legacy-list",
+            iterations, size);
+    }
+
+    return results;
+}
+
+struct bench_signal_provider_t : public wf::signal_provider_t
+{};
+
+/** Emit a signal with the given number of connections by name and by ID */
+std::vector<micro_result_t> bench_signals(wf::output_t*, int iterations)
+{
+    std::vector<micro_result_t> results;
+    for (int count : {0, 1, 8})
+    {
+        bench_signal_provider_t provider;
+        /* Other signals on the same provider, as on a typical view */
+        std::vector<std::unique_ptr<wf::signal_connection_t>> connections;
+        for (auto name : {"geometry-changed", "title-changed", "unmap"})
+        {
+            connections.push_back(std::make_unique<wf::signal_connection_t>(
+                [] (wf::signal_data_t*) {}));
+            provider.connect_signal(name, connections.back().get());
+        }
+
+        int64_t calls = 0;
+        for (int i = 0; i < count; i++)
+        {
+            connections.push_back(std::make_unique<wf::signal_connection_t>(
+                [&] (wf::signal_data_t*) { ++calls; }));
+            provider.connect_signal("bench-signal", connections.back().get());
+        }
+
+        wf::signal_data_t data;
+        auto suffix = "-" + std::to_string(count);
+        time_op(results, "emit-by-name" + suffix, iterations, [&] (int)
+        {
+            provider.emit_signal("bench-signal", &data);
+        });
+
+        static const wf::signal_id_t bench_signal{"bench-signal"};
+        time_op(results, "emit-by-id" + suffix, iterations, [&] (int)
+        {
+            provider.emit_signal(bench_signal, &data);
+        });
+
+        sink = calls;
+        for (auto& connection : connections)
+            provider.disconnect_signal(connection.get());
+    }
+
+    return results;
+}
+
+/**
+ * Evaluate a typical window rule over thousands of views, with the matcher
+ * AST and with matchers which compile their pattern on every evaluation and
+ * copy the view, as they used to.
+ */
+std::vector<micro_result_t> bench_matcher(wf::output_t*, int iterations)
+{
+    const int nr_views = 2000;
+    std::vector<wf::matcher::view_t> views(nr_views);
+    for (int i = 0; i < nr_views; i++)
+    {
+        views[i].type = "toplevel";
+        views[i].app_id = (i % 4 == 0) ? "firefox" : "app-" + std::to_string(i);
+        views[i].title = "Document " + std::to_string(i) +
+            ((i % 3 == 0) ? " - Mail" : " - Editor");
+        views[i].focuseable = "true";
+    }
+
+    std::vector<micro_result_t> results;
+    auto expression = wf::matcher::parse_expression(
+        "(app-id is firefox || title contains Mail)").first;
+
+    int64_t matched = 0;
+    time_op(results, "matcher-ast", iterations, [&] (int i)
+    {
+        matched += expression->evaluate(views[i % nr_views]);
+    });
+
+    using legacy_func_t = std::function<bool(std::string, std::string)>;
+    legacy_func_t legacy_exact = [] (std::string text, std::string pattern)
+    {
+        return std::regex_match(text, std::regex(pattern));
+    };
+    legacy_func_t legacy_contains = [] (std::string text, std::string pattern)
+    {
+        return text.find(pattern) != text.npos;
+    };
+
+    time_op(results, "matcher-legacy", iterations, [&] (int i)
+    {
+        wf::matcher::view_t view = views[i % nr_views];
+        matched += legacy_exact(view.app_id, "firefox") ||
+            legacy_contains(view.title, "Mail");
+    });
+
+    sink = matched;
+    return results;
+}
+
+/**
+ * Find the surface at points spread over the output, through core (which
+ * uses a spatial index) and by walking all views of the output, as core
+ * used to. The results depend on the views present on the output.
+ */
+std::vector<micro_result_t> bench_hit_test(wf::output_t *output, int iterations)
+{
+    auto og = output->get_layout_geometry();
+    auto get_point = [&] (int i) -> wf::pointf_t
+    {
+        /* A fixed pseudo-random sequence of points */
+        uint32_t hash = i * 2654435761u;
+        return {og.x + 1.0 * (hash % 4093) / 4093 * og.width,
+            og.y + 1.0 * ((hash >> 12) % 4091) / 4091 * og.height};
+    };
+
+    std::vector<micro_result_t> results;
+    int64_t hits = 0;
+    wf::pointf_t local;
+    time_op(results, "hit-test-index", iterations, [&] (int i)
+    {
+        hits += (wf::get_core().get_surface_at(get_point(i), local) != nullptr);
+    });
+
+    time_op(results, "hit-test-linear", iterations, [&] (int i)
+    {
+        auto point = get_point(i);
+        point.x -= og.x;
+        point.y -= og.y;
+        for (auto& v :
+            output->workspace->get_views_in_layer(wf::VISIBLE_LAYERS))
+        {
+            for (auto& view : v->enumerate_views())
+            {
+                if (view->map_input_coordinates(point, local))
+                {
+                    ++hits;
+                    return;
+                }
+            }
+        }
+    });
+
+    sink = hits;
+    return results;
+}
+
+/**
+ * Reallocate a framebuffer at its current size, while the pool of framebuffers
+ * holds an idle buffer of the same size. The framebuffer has to keep its
+ * buffer, so this also checks that neither the buffer nor the accounted GPU
+ * memory change.
+ */
+std::vector<micro_result_t> bench_framebuffer_pool(wf::output_t*, int iterations)
+{
+    std::vector<micro_result_t> results;
+    wf::framebuffer_base_t buffer, idle;
+    buffer.owner = idle.owner = "bench";
+
+    OpenGL::render_begin();
+    buffer.allocate(64, 64);
+    idle.allocate(64, 64);
+    idle.release();
+    if (OpenGL::get_framebuffer_pool_stats().pooled_buffers == 0)
+        LOGW("bench: the framebuffer pool is disabled, nothing to check");
+
+    GLuint fb = buffer.fb, tex = buffer.tex;
+    uint64_t memory = OpenGL::get_total_gpu_memory_usage();
+    time_op(results, "framebuffer-reallocate", iterations, [&] (int)
+    {
+        buffer.allocate(64, 64);
+    });
+
+    if (buffer.fb != fb || buffer.tex != tex ||
+        OpenGL::get_total_gpu_memory_usage() != memory)
+    {
+        LOGE("bench: reallocating a framebuffer at the same size ",
+            "replaced its buffer");
+    }
+
+    buffer.release();
+    OpenGL::render_end();
+    return results;
+}
+
+using micro_benchmark_t =
+    std::function<std::vector<micro_result_t>(wf::output_t*, int)>;
+
+const std::map<std::string, micro_benchmark_t> micro_benchmarks = {
+    {"safe-list", bench_safe_list},
+    {"signal", bench_signals},
+    {"matcher", bench_matcher},
+    {"hit-test", bench_hit_test},
+    {"framebuffer-pool", bench_framebuffer_pool},
+};
+}
+
+std::vector<micro_result_t> run_micro_benchmark(const std::string& name,
+    wf::output_t *output, int iterations)
+{
+    auto it = micro_benchmarks.find(name);
+    if (it == micro_benchmarks.end())
+        return {};
+
+    return it->second(output, std::max(1, iterations));
+}
+}
+}
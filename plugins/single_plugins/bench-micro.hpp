@@ -0,0 +1,37 @@
+#ifndef BENCH_MICRO_HPP
+#define BENCH_MICRO_HPP
+
+#include <wayfire/output.hpp>
+#include <string>
+#include <vector>
+
+namespace wf
+{
+namespace bench
+{
+/** The time taken by a single operation of a micro-benchmark */
+struct micro_result_t
+{
+    std::string name;
+    double nsec_per_op;
+};
+
+/**
+ * Run the micro-benchmark with the given name.
+ *
+ * Micro-benchmarks time core data structures in isolation, usually
+ * comparing them against the straightforward implementation they replace.
+ *
+ * @param name The name of the benchmark.
+ * @param output The output the benchmark runs on.
+ * @param iterations The number of operations to time.
+ *
+ * @return The timed operations, or an empty list if there is no such
+ *   benchmark.
+ */
+std::vector<micro_result_t> run_micro_benchmark(const std::string& name,
+    wf::output_t *output, int iterations);
+}
+}
+
+#endif /* end of include guard: BENCH_MICRO_HPP */
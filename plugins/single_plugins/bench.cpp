@@ -0,0 +1,376 @@
+#include <wayfire/plugin.hpp>
+#include <wayfire/output.hpp>
+#include <wayfire/core.hpp>
+#include <wayfire/view.hpp>
+#include <wayfire/workspace-manager.hpp>
+#include <wayfire/render-manager.hpp>
+#include <wayfire/opengl.hpp>
+#include <wayfire/signal-definitions.hpp>
+#include <wayfire/util/log.hpp>
+#include "../cube/cube-control-signal.hpp"
+#include "toggle-signal.hpp"
+#include "bench-micro.hpp"
+
+#include <sys/resource.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cmath>
+
+/**
+ * The bench plugin drives a scripted workload on the output it is enabled on
+ * and reports the frame timings recorded by the render manager, together
+ * with the CPU usage of the compositor during the run.
+ *
+ * Before the scripted workload, it can also run micro-benchmarks of core
+ * data structures, see bench-micro.hpp.
+ *
+ * It is meant to be run on the headless backend with a software renderer,
+ * for ex. WLR_BACKENDS=headless WLR_RENDERER_ALLOW_SOFTWARE=1
+ * LIBGL_ALWAYS_SOFTWARE=1, so that results can be compared between releases
+ * without real GPUs.
+ */
+
+/* Marks that the benchmark clients have already been started, so that they
+ * are not started once per output */
+struct bench_clients_started_t : public wf::custom_data_t {};
+
+class wayfire_bench : public wf::plugin_interface_t
+{
+    wf::option_wrapper_t<int> duration{"bench/duration"};
+    wf::option_wrapper_t<int> step_duration{"bench/step_duration"};
+    wf::option_wrapper_t<std::string> script{"bench/script"};
+    wf::option_wrapper_t<std::string> client_command{"bench/client_command"};
+    wf::option_wrapper_t<int> client_count{"bench/client_count"};
+    wf::option_wrapper_t<std::string> report_file{"bench/report_file"};
+    wf::option_wrapper_t<std::string> micro{"bench/micro"};
+    wf::option_wrapper_t<int> micro_iterations{"bench/micro_iterations"};
+
+    std::vector<std::string> steps;
+    size_t current_step = 0;
+    int move_direction = 1;
+
+    /* Cube rotation is animated per-frame for the duration of a step */
+    bool rotating_cube = false;
+    uint32_t step_start = 0;
+
+    /* Plugins activated by a step are deactivated half-way through it,
+     * by calling the toggle again */
+    std::function<bool()> deactivate_step;
+
+    std::vector<wf::frame_timings_t> frames;
+    OpenGL::framebuffer_pool_stats_t start_pool_stats;
+    timeval start_utime, start_stime;
+    uint32_t start_time;
+    bool running = false;
+
+    wf::wl_timer step_timer, end_timer, deactivate_timer;
+
+  public:
+    void init() override
+    {
+        grab_interface->name = "bench";
+        grab_interface->capabilities = 0;
+
+        std::istringstream stream{(std::string)script};
+        std::string step;
+        while (stream >> step)
+            steps.push_back(step);
+
+        start_clients();
+
+        /* Give the clients some time to start up before measuring */
+        step_timer.set_timeout(1000, [=] () { start(); });
+    }
+
+    void start_clients()
+    {
+        auto& core = wf::get_core();
+        if (core.has_data<bench_clients_started_t>())
+            return;
+
+        core.store_data(std::make_unique<bench_clients_started_t>());
+        std::string command = client_command;
+        if (command.empty())
+            return;
+
+        for (int i = 0; i < client_count; i++)
+            core.run(command);
+    }
+
+    void start()
+    {
+        run_micro_benchmarks();
+
+        running = true;
+        frames.clear();
+
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        start_utime = usage.ru_utime;
+        start_stime = usage.ru_stime;
+        start_time = wf::get_current_time();
+        start_pool_stats = OpenGL::get_framebuffer_pool_stats();
+
+        output->render->connect_signal("frame-timings", &on_frame_timings);
+        output->render->add_effect(&cube_hook, wf::OUTPUT_EFFECT_PRE);
+        end_timer.set_timeout(std::max(1, (int)duration) * 1000,
+            [=] () { finish(); });
+
+        LOGI("bench: starting a ", (int)duration, "s run on ",
+            output->to_string());
+        run_step();
+    }
+
+    void run_step()
+    {
+        if (!running)
+            return;
+
+        end_step_activation();
+        if (!steps.empty())
+        {
+            const auto& step = steps[current_step];
+            current_step = (current_step + 1) % steps.size();
+
+            if (step == "workspace")
+                switch_workspace();
+            else if (step == "move")
+                move_views();
+            else if (step == "cube")
+                start_cube_rotation();
+            else if (step == "expo" || step == "switcher")
+                activate_for_step([=] () { return toggle_plugin(step); });
+            else if (step == "blur")
+                activate_for_step([=] () { return toggle_blur(); });
+            else if (step != "idle")
+                LOGE("bench: unknown step ", step);
+        }
+
+        output->render->schedule_redraw();
+        step_timer.set_timeout(std::max(1, (int)step_duration),
+            [=] () { run_step(); });
+    }
+
+    void switch_workspace()
+    {
+        auto grid = output->workspace->get_workspace_grid_size();
+        auto ws = output->workspace->get_current_workspace();
+
+        ws.x++;
+        if (ws.x >= grid.width)
+        {
+            ws.x = 0;
+            ws.y = (ws.y + 1) % grid.height;
+        }
+
+        output->workspace->request_workspace(ws);
+    }
+
+    void move_views()
+    {
+        auto views = output->workspace->get_views_in_layer(wf::WM_LAYERS);
+        for (auto& view : views)
+        {
+            if (!view->is_mapped())
+                continue;
+
+            auto geometry = view->get_wm_geometry();
+            view->move(geometry.x + 50 * move_direction, geometry.y);
+        }
+
+        move_direction *= -1;
+    }
+
+    void start_cube_rotation()
+    {
+        rotating_cube = true;
+        step_start = wf::get_current_time();
+    }
+
+    /** Toggle a plugin which listens for plugin_toggle_signal */
+    bool toggle_plugin(const std::string& name)
+    {
+        plugin_toggle_signal data;
+        output->emit_signal(name + "-toggle", &data);
+        if (!data.carried_out)
+            LOGW("bench: could not toggle ", name, ", is the plugin enabled?");
+
+        return data.carried_out;
+    }
+
+    /** Toggle between automatic and manual blurring of all views */
+    bool toggle_blur()
+    {
+        auto option = wf::get_core().config.get_option("blur/mode");
+        if (!option)
+        {
+            LOGW("bench: could not toggle blur, is the plugin enabled?");
+            return false;
+        }
+
+        option->set_value_str(
+            option->get_value_str() == "normal" ? "toggle" : "normal");
+        return true;
+    }
+
+    /** Run the toggle now, and again half-way through the step */
+    void activate_for_step(std::function<bool()> toggle)
+    {
+        if (!toggle())
+            return;
+
+        deactivate_step = toggle;
+        deactivate_timer.set_timeout(std::max(1, (int)step_duration / 2),
+            [=] () { end_step_activation(); });
+    }
+
+    void end_step_activation()
+    {
+        deactivate_timer.disconnect();
+        if (deactivate_step)
+        {
+            auto toggle = std::move(deactivate_step);
+            deactivate_step = nullptr;
+            toggle();
+        }
+    }
+
+    wf::effect_hook_t cube_hook = [=] ()
+    {
+        if (!rotating_cube)
+            return;
+
+        double progress = 1.0 * (wf::get_current_time() - step_start) /
+            std::max(1, (int)step_duration);
+        progress = std::min(progress, 1.0);
+
+        cube_control_signal data;
+        data.angle = 2 * M_PI * progress;
+        data.zoom = 1.0;
+        data.ease = std::sin(M_PI * progress);
+        data.last_frame = (progress >= 1.0);
+        data.carried_out = false;
+        output->emit_signal("cube-control", &data);
+
+        rotating_cube = !data.last_frame && data.carried_out;
+        if (rotating_cube)
+            output->render->schedule_redraw();
+    };
+
+    wf::signal_callback_t on_frame_timings = [=] (wf::signal_data_t *data)
+    {
+        auto ev = static_cast<wf::frame_timings_signal*>(data);
+        frames.push_back(ev->timings);
+    };
+
+    void run_micro_benchmarks()
+    {
+        std::istringstream stream{(std::string)micro};
+        std::string name;
+        while (stream >> name)
+        {
+            auto results =
+                wf::bench::run_micro_benchmark(name, output, micro_iterations);
+            if (results.empty())
+            {
+                LOGE("bench: unknown micro-benchmark ", name);
+                continue;
+            }
+
+            std::ostringstream report;
+            report << "output=" << output->to_string() << " micro=" << name;
+            for (auto& result : results)
+                report << " " << result.name << "_ns=" << result.nsec_per_op;
+
+            write_report(report.str());
+        }
+    }
+
+    /** Write a line to the log and the report file */
+    void write_report(const std::string& line)
+    {
+        LOGI("bench: ", line);
+
+        std::string file = report_file;
+        if (!file.empty())
+        {
+            std::ofstream out{file, std::ios::app};
+            out << line << std::endl;
+        }
+    }
+
+    static double usec_diff(const timeval& end, const timeval& start)
+    {
+        return (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_usec - start.tv_usec);
+    }
+
+    void finish()
+    {
+        if (!running)
+            return;
+
+        stop();
+
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        double wall_usec = (wf::get_current_time() - start_time) * 1000.0;
+        double cpu_usec = usec_diff(usage.ru_utime, start_utime) +
+            usec_diff(usage.ru_stime, start_stime);
+
+        std::ostringstream report;
+        report << "output=" << output->to_string()
+            << " frames=" << frames.size()
+            << " fps=" << frames.size() / (wall_usec / 1e6)
+            << " cpu=" << 100.0 * cpu_usec / wall_usec << "%";
+
+        auto p50 = wf::get_frame_timings_percentile(frames, 50);
+        auto p95 = wf::get_frame_timings_percentile(frames, 95);
+        auto p99 = wf::get_frame_timings_percentile(frames, 99);
+        auto report_field = [&] (std::string name, auto field)
+        {
+            report << " " << name << "_ms="
+                << field(p50) / 1000.0 << "/"
+                << field(p95) / 1000.0 << "/"
+                << field(p99) / 1000.0;
+        };
+
+        report_field("frame", [] (auto& f) { return f.frame_usec; });
+        for (int i = 0; i < wf::FRAME_PHASE_TOTAL; i++)
+        {
+            static const char *names[] = {"damage", "render", "overlay",
+                "cursors", "postprocess", "swap", "frame_done"};
+            report_field(names[i], [i] (auto& f) { return f.phase_usec[i]; });
+        }
+
+        report << " surfaces=" << p50.rendered_surfaces;
+        report << " damaged_px=" << p50.damaged_area;
+        report << " fused_passes=" << p50.fused_transformer_passes;
+
+        auto pool_stats = OpenGL::get_framebuffer_pool_stats();
+        report << " fb_pool_hits=" << pool_stats.hits - start_pool_stats.hits
+            << " fb_pool_misses=" << pool_stats.misses - start_pool_stats.misses
+            << " fb_pool_kib=" << pool_stats.pooled_bytes / 1024
+            << " gpu_mem_kib=" << OpenGL::get_total_gpu_memory_usage() / 1024;
+
+        write_report(report.str());
+    }
+
+    void stop()
+    {
+        end_step_activation();
+        running = false;
+        rotating_cube = false;
+        step_timer.disconnect();
+        end_timer.disconnect();
+        output->render->disconnect_signal("frame-timings", &on_frame_timings);
+        output->render->rem_effect(&cube_hook);
+    }
+
+    void fini() override
+    {
+        stop();
+    }
+};
+
+DECLARE_WAYFIRE_PLUGIN(wayfire_bench);
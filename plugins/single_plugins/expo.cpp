@@ -9,12 +9,15 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <wayfire/util/duration.hpp>
+#include <wayfire/util.hpp>
+#include <cmath>
 #include <wayfire/plugins/common/view-change-viewport-signal.hpp>
 
 /* TODO: this file should be included in some header maybe(plugin.hpp) */
 #include <linux/input-event-codes.h>
 #include "../wobbly/wobbly-signal.hpp"
 #include "move-snap-helper.hpp"
+#include "toggle-signal.hpp"
 
 using namespace wf::animation;
 
@@ -63,6 +66,12 @@ class wayfire_expo : public wf::plugin_interface_t
         return false;
     };
 
+    wf::signal_callback_t on_toggle_signal = [=] (wf::signal_data_t *data)
+    {
+        auto ev = static_cast<plugin_toggle_signal*>(data);
+        ev->carried_out = toggle_cb(wf::ACTIVATOR_SOURCE_KEYBINDING, 0);
+    };
+
     wf::option_wrapper_t<wf::activatorbinding_t> toggle_binding{"expo/toggle"};
     wf::option_wrapper_t<wf::color_t> background_color{"expo/background"};
     wf::option_wrapper_t<int> zoom_duration{"expo/duration"};
@@ -73,7 +82,7 @@ class wayfire_expo : public wf::plugin_interface_t
     std::vector<wf::activator_callback> keyboard_select_cbs;
     std::vector<wf::option_sptr_t<wf::activatorbinding_t>> keyboard_select_options;
 
-    wf::render_hook_t renderer;
+    wf::damage_render_hook_t renderer;
     wf::signal_callback_t view_removed = [=] (wf::signal_data_t *event)
     {
         if (get_signaled_view(event) == moving_view)
@@ -192,10 +201,12 @@ class wayfire_expo : public wf::plugin_interface_t
             finalize_and_exit();
         };
 
-        renderer = [=] (const wf::framebuffer_t& buffer) { render(buffer); };
+        renderer = [=] (const wf::framebuffer_t& buffer,
+            const wf::region_t& damage) { return render(buffer, damage); };
 
         output->connect_signal("detach-view", &view_removed);
         output->connect_signal("view-disappeared", &view_removed);
+        output->connect_signal("expo-toggle", &on_toggle_signal);
     }
 
     bool activate()
@@ -214,7 +225,7 @@ class wayfire_expo : public wf::plugin_interface_t
         target_vy = cws.y;
         calculate_zoom(true);
 
-        output->render->set_renderer(renderer);
+        output->render->set_damage_renderer(renderer);
         output->render->schedule_redraw();
 
         for (size_t i = 0; i < keyboard_select_cbs.size(); i++)
@@ -436,7 +447,8 @@ class wayfire_expo : public wf::plugin_interface_t
             {
                 if (!streams[i][j].running)
                 {
-                    output->render->workspace_stream_start(streams[i][j]);
+                    output->render->workspace_stream_start(streams[i][j],
+                        animation.scale_x, animation.scale_y);
                 } else
                 {
                     output->render->workspace_stream_update(streams[i][j],
@@ -446,14 +458,93 @@ class wayfire_expo : public wf::plugin_interface_t
         }
     }
 
+    /**
+     * Get the box of the output where the given workspace is shown, in
+     * output-local coordinates, not counting the delimiter offset.
+     */
+    wf::geometry_t get_workspace_thumbnail(wf::point_t ws)
+    {
+        auto og = output->get_relative_geometry();
+        auto cws = output->workspace->get_current_workspace();
+
+        /* Same as the transform in render(), but in output-local coordinates
+         * instead of GL coordinates */
+        double x1 = animation.off_x + animation.scale_x * ((ws.x - cws.x) * 2.0 - 1);
+        double y1 = animation.off_y + animation.scale_y * ((cws.y - ws.y) * 2.0 + 1);
+
+        return {
+            (int)std::floor((x1 + 1) / 2 * og.width),
+            (int)std::floor((1 - y1) / 2 * og.height),
+            (int)std::ceil(animation.scale_x * og.width),
+            (int)std::ceil(animation.scale_y * og.height),
+        };
+    }
+
+    /**
+     * Calculate the part of the output which changes in this frame.
+     *
+     * @param damage The damage of the frame, in output-local coordinates.
+     */
+    wf::region_t get_repainted_region(const wf::region_t& damage)
+    {
+        auto og = output->get_relative_geometry();
+        /* The whole scene moves while zooming */
+        if (animation.running())
+            return og;
+
+        /* Damage on the output itself, for ex. when expo is started or when
+         * an older buffer is reused */
+        wf::region_t repainted = damage & og;
+
+        /* The thumbnails are not exactly scaled workspaces because of the
+         * delimiter offset, so leave some room for rounding */
+        int padding = std::ceil((double)animation.delimiter_offset) + 1;
+
+        auto wsize = output->workspace->get_workspace_grid_size();
+        for (int j = 0; j < wsize.height; j++)
+        {
+            for (int i = 0; i < wsize.width; i++)
+            {
+                auto ws_box = output->render->get_ws_box({i, j});
+                auto ws_damage = damage & ws_box;
+                if (ws_damage.empty())
+                    continue;
+
+                auto thumbnail = get_workspace_thumbnail({i, j});
+                double sx = 1.0 * thumbnail.width / og.width;
+                double sy = 1.0 * thumbnail.height / og.height;
+                for (const auto& rect : ws_damage)
+                {
+                    int x1 = std::floor((rect.x1 - ws_box.x) * sx);
+                    int y1 = std::floor((rect.y1 - ws_box.y) * sy);
+                    int x2 = std::ceil((rect.x2 - ws_box.x) * sx);
+                    int y2 = std::ceil((rect.y2 - ws_box.y) * sy);
+
+                    repainted |= wf::geometry_t{
+                        thumbnail.x + x1 - padding,
+                        thumbnail.y + y1 - padding,
+                        x2 - x1 + 2 * padding,
+                        y2 - y1 + 2 * padding,
+                    };
+                }
+            }
+        }
+
+        return repainted & og;
+    }
+
     /* Renders a grid of all active workspaces. It "renders" the workspaces
      * in their correct place/size, then scales+translates the whole scene so
      * that all of the workspaces become visible.
      *
-     * The scale+translate part is calculated in zoom_target */
-    void render(const wf::framebuffer_t &fb)
+     * The scale+translate part is calculated in zoom_target.
+     *
+     * Only the thumbnails of damaged workspaces are repainted, unless the
+     * zoom is being animated. */
+    wf::region_t render(const wf::framebuffer_t &fb, const wf::region_t& damage)
     {
         update_streams();
+        auto repainted = get_repainted_region(damage);
 
         auto wsize = output->workspace->get_workspace_grid_size();
         auto cws = output->workspace->get_current_workspace();
@@ -463,27 +554,38 @@ class wayfire_expo : public wf::plugin_interface_t
         auto scale     = glm::scale(glm::mat4(1.0), glm::vec3((double)animation.scale_x, (double)animation.scale_y, 1));
         auto scene_transform = fb.transform * translate * scale; // scale+translate part
 
-        OpenGL::render_begin(fb);
-        OpenGL::clear(background_color);
-        fb.logic_scissor(fb.geometry);
-
         /* Space between adjacent workspaces */
         float hspacing = 1.0 * animation.delimiter_offset / screen_size.width;
         float vspacing = 1.0 * animation.delimiter_offset / screen_size.height;
         if (fb.wl_transform & 1)
             std::swap(hspacing, vspacing);
 
+        /* First, center each workspace on the output, taking spacing into account */
+        gl_geometry out_geometry = {
+            .x1 = -1 + hspacing,
+            .y1 = 1 - vspacing,
+            .x2 = 1 - hspacing,
+            .y2 = -1 + vspacing,
+        };
+
+        OpenGL::render_begin(fb);
+        for (const auto& rect : repainted)
+        {
+            fb.logic_scissor(wlr_box_from_pixman_box(rect));
+            OpenGL::clear(background_color);
+        }
+
         for(int j = 0; j < wsize.height; j++)
         {
             for(int i = 0; i < wsize.width; i++)
             {
-                /* First, center each workspace on the output, taking spacing into account */
-                gl_geometry out_geometry = {
-                    .x1 = -1 + hspacing,
-                    .y1 = 1 - vspacing,
-                    .x2 = 1 - hspacing,
-                    .y2 = -1 + vspacing,
-                };
+                /* Draw each thumbnail once, scissored to the extents of its
+                 * repainted part. The streams are opaque, so redrawing the
+                 * parts of the thumbnail which did not change is harmless. */
+                auto thumbnail_damage =
+                    repainted & get_workspace_thumbnail({i, j});
+                if (thumbnail_damage.empty())
+                    continue;
 
                 /* Then, calculate translation matrix so that the workspace gets
                  * in its correct position relative to the focused workspace */
@@ -495,6 +597,8 @@ class wayfire_expo : public wf::plugin_interface_t
                 /* Undo rotation of the workspace */
                 workspace_transform = workspace_transform * glm::inverse(fb.transform);
 
+                fb.logic_scissor(
+                    wlr_box_from_pixman_box(thumbnail_damage.get_extents()));
                 OpenGL::render_transformed_texture(streams[i][j].buffer.tex,
                     out_geometry, {}, workspace_transform);
             }
@@ -511,6 +615,8 @@ class wayfire_expo : public wf::plugin_interface_t
         {
             finalize_and_exit();
         }
+
+        return repainted;
     }
 
     void calculate_zoom(bool zoom_in)
@@ -566,6 +672,7 @@ class wayfire_expo : public wf::plugin_interface_t
     {
         output->disconnect_signal("detach-view", &view_removed);
         output->disconnect_signal("view-disappeared", &view_removed);
+        output->disconnect_signal("expo-toggle", &on_toggle_signal);
 
         if (state.active)
             finalize_and_exit();
@@ -14,6 +14,7 @@
 #include <wayfire/util/duration.hpp>
 #include <wayfire/nonstd/reverse.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include "toggle-signal.hpp"
 
 #include <algorithm>
 #include <exception>
@@ -118,6 +119,7 @@ class WayfireSwitcher : public wf::plugin_interface_t
             wf::option_wrapper_t<wf::touchgesture_t>{"switcher/gesture_toggle"},
             &touch_activate);
         output->connect_signal("detach-view", &view_removed);
+        output->connect_signal("switcher-toggle", &on_toggle_signal);
 
         grab_interface->callbacks.keyboard.mod = [=] (uint32_t mod, uint32_t state)
         {
@@ -164,6 +166,21 @@ class WayfireSwitcher : public wf::plugin_interface_t
         return true;
     };
 
+    /* Like the touch gesture, there are no modifiers to release, so the
+     * switcher is closed by a second toggle */
+    wf::signal_callback_t on_toggle_signal = [=] (wf::signal_data_t *data)
+    {
+        auto ev = static_cast<plugin_toggle_signal*>(data);
+        if (!active)
+        {
+            ev->carried_out = handle_switch_request(-1);
+        } else
+        {
+            handle_done();
+            ev->carried_out = true;
+        }
+    };
+
     wf::effect_hook_t damage = [=] ()
     {
         output->render->damage_whole();
@@ -789,6 +806,7 @@ class WayfireSwitcher : public wf::plugin_interface_t
         output->rem_binding(&prev_view_binding);
         output->rem_binding(&touch_activate);
         output->disconnect_signal("detach-view", &view_removed);
+        output->disconnect_signal("switcher-toggle", &on_toggle_signal);
     }
 };
 
@@ -0,0 +1,17 @@
+#ifndef PLUGIN_TOGGLE_SIGNAL
+#define PLUGIN_TOGGLE_SIGNAL
+
+#include <wayfire/signal-definitions.hpp>
+
+/* A private signal, currently shared by bench, expo & switcher
+ *
+ * It is emitted on the output as expo-toggle or switcher-toggle, to activate
+ * or deactivate the plugin like its binding would, so that it can be driven
+ * by scripted benchmarks.
+ */
+struct plugin_toggle_signal : public wf::signal_data_t
+{
+    bool carried_out = false; // false if the plugin is disabled or busy
+};
+
+#endif /* end of include guard: PLUGIN_TOGGLE_SIGNAL */
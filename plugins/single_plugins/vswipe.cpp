@@ -11,6 +11,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <wayfire/util/duration.hpp>
+#include <wayfire/util.hpp>
 
 #include <cmath>
 #include <utility>
@@ -48,7 +49,9 @@ class vswipe : public wf::plugin_interface_t
             int vh = 0;
         } state;
 
-        wf::render_hook_t renderer;
+        wf::damage_render_hook_t renderer;
+        /* The swipe offset of the last rendered frame */
+        double last_rendered_delta = NAN;
         wf::option_wrapper_t<bool> enable_horizontal{"vswipe/enable_horizontal"};
         wf::option_wrapper_t<bool> enable_vertical{"vswipe/enable_vertical"};
         wf::option_wrapper_t<bool> smooth_transition{"vswipe/enable_smooth_transition"};
@@ -75,7 +78,8 @@ class vswipe : public wf::plugin_interface_t
         wf::get_core().connect_signal("pointer_swipe_begin", &on_swipe_begin);
         wf::get_core().connect_signal("pointer_swipe_update", &on_swipe_update);
         wf::get_core().connect_signal("pointer_swipe_end", &on_swipe_end);
-        renderer = [=] (const wf::framebuffer_t& buffer) { render(buffer); };
+        renderer = [=] (const wf::framebuffer_t& buffer,
+            const wf::region_t& damage) { return render(buffer, damage); };
     }
 
     /**
@@ -99,18 +103,110 @@ class vswipe : public wf::plugin_interface_t
         assert(false); // not reached
     }
 
-    void render(const wf::framebuffer_t &fb)
+    /**
+     * Get the output-local position of the top-left corner of the workspace
+     * with the given offset. Depends on the swipe direction.
+     */
+    wf::point_t get_workspace_position(double offset)
+    {
+        auto og = output->get_relative_geometry();
+        switch (state.direction)
+        {
+            case UNKNOWN:
+                return {0, 0};
+            case HORIZONTAL:
+                return {(int)std::round(offset / 2 * og.width), 0};
+            case VERTICAL:
+                return {0, (int)std::round(offset / 2 * og.height)};
+        }
+
+        assert(false); // not reached
+    }
+
+    /**
+     * Calculate the part of the output which changes in this frame.
+     *
+     * @param damage The damage of the frame, in output-local coordinates.
+     */
+    wf::region_t get_repainted_region(const wf::region_t& damage)
+    {
+        auto og = output->get_relative_geometry();
+        double delta = smooth_delta;
+
+        /* All workspaces move when the offset changes */
+        if (delta != last_rendered_delta)
+        {
+            last_rendered_delta = delta;
+            return og;
+        }
+
+        /* Damage on the output itself, for ex. when an older buffer is
+         * reused */
+        wf::region_t repainted = damage & og;
+
+        auto add_stream_damage = [&] (wf::workspace_stream_t& s, double offset)
+        {
+            if (s.ws.x < 0 || s.ws.y < 0)
+                return;
+
+            auto ws_box = output->render->get_ws_box(s.ws);
+            auto position = get_workspace_position(offset + delta * 2);
+            auto ws_damage = (damage & ws_box) +
+                wf::point_t{position.x - ws_box.x, position.y - ws_box.y};
+
+            /* The workspace position is rounded, leave a pixel for that */
+            for (const auto& rect : ws_damage)
+            {
+                repainted |= wf::geometry_t{rect.x1 - 1, rect.y1 - 1,
+                    rect.x2 - rect.x1 + 2, rect.y2 - rect.y1 + 2};
+            }
+        };
+
+        add_stream_damage(streams.prev, -2.0 - state.gap * 2.0);
+        add_stream_damage(streams.curr, 0.0);
+        add_stream_damage(streams.next, 2.0 + state.gap * 2.0);
+
+        return repainted & og;
+    }
+
+    wf::region_t render(const wf::framebuffer_t &fb, const wf::region_t& damage)
     {
         if (!smooth_delta.running() && !state.swiping)
             finalize_and_exit();
 
+        auto repainted = get_repainted_region(damage);
+
         update_stream(streams.prev);
         update_stream(streams.curr);
         update_stream(streams.next);
 
         OpenGL::render_begin(fb);
-        OpenGL::clear(background_color);
-        fb.scissor(fb.framebuffer_box_from_geometry_box(fb.geometry));
+        for (const auto& rect : repainted)
+        {
+            fb.logic_scissor(wlr_box_from_pixman_box(rect));
+            OpenGL::clear(background_color);
+        }
+
+        /* Draw the workspaces once, scissored to the extents of the repainted
+         * region. The streams are opaque, so redrawing the parts which did
+         * not change is harmless. */
+        if (!repainted.empty())
+        {
+            fb.logic_scissor(wlr_box_from_pixman_box(repainted.get_extents()));
+            render_workspaces(fb);
+        }
+
+        GL_CALL(glUseProgram(0));
+        OpenGL::render_end();
+
+        return repainted;
+    }
+
+    /**
+     * Render the swiped workspaces, using the current scissor box.
+     */
+    void render_workspaces(const wf::framebuffer_t &fb)
+    {
 
         gl_geometry out_geometry = {
             .x1 = -1,
@@ -140,9 +236,6 @@ class vswipe : public wf::plugin_interface_t
             OpenGL::render_transformed_texture(streams.next.buffer.tex,
                 out_geometry, {}, fb.transform * next * swipe);
         }
-
-        GL_CALL(glUseProgram(0));
-        OpenGL::render_end();
     }
 
     inline void update_stream(wf::workspace_stream_t& s)
@@ -214,7 +307,8 @@ class vswipe : public wf::plugin_interface_t
         grab_interface->grab();
         wf::get_core().focus_output(output);
 
-        output->render->set_renderer(renderer);
+        last_rendered_delta = NAN;
+        output->render->set_damage_renderer(renderer);
         if (!was_active)
             output->render->set_redraw_always();
 
@@ -1,11 +1,14 @@
 #include <wayfire/plugin.hpp>
 #include <wayfire/output.hpp>
+#include <wayfire/render-manager.hpp>
 #include <wayfire/view.hpp>
 #include <cwctype>
 #include <cstdio>
 #include <wayfire/signal-definitions.hpp>
 #include <assert.h>
 #include <map>
+#include <unordered_map>
+#include <algorithm>
 #include <cfloat>
 #include "wayfire/view-transform.hpp"
 
@@ -15,7 +18,8 @@ using std::string;
 rules syntax:
 
 title (T) / title contains (T) / app-id (T) / app-id contains (T) (created/destroyed/maximized/fullscreened) ->
-    move X Y | resize W H | (un)set fullscreen | (un)set maximized | set alpha A
+    move X Y | resize W H | (un)set fullscreen | (un)set maximized | set alpha A |
+    set occluded_frame_rate R
 
 where (T) is a text surrounded by parenthesis, for ex. (tilix)
 contains (T) means that (T) can be found anywhere in the title/app-id string
@@ -23,10 +27,14 @@ contains (T) means that (T) can be found anywhere in the title/app-id string
 X Y W H are simply integers indicating the position where the view
 should be placed and W H are positive integers indicating size
 
+R is the number of frames per second the view may draw while it is fully
+covered by other views, 0 for none and -1 to never throttle the view
+
 examples:
 
 title contains Chrome created -> set maximized
 app-id tilix created -> move 0 0
+app-id mpv created -> set occluded_frame_rate -1
 
  */
 
@@ -53,46 +61,130 @@ static bool ends_with(string x, string y)
 }
 
 
+/**
+ * substring_index_t finds all patterns which occur in a given text in a single
+ * pass over the text, using the Aho-Corasick algorithm. This way the matching
+ * cost does not depend on the number of patterns.
+ */
+class substring_index_t
+{
+    struct node_t
+    {
+        std::map<char, int> next;
+        int fail = 0;
+        /* Patterns which end at this node or at a node in its fail chain */
+        std::vector<size_t> outputs;
+    };
+
+    std::vector<node_t> nodes = {node_t{}};
+    /* Empty patterns match every text */
+    std::vector<size_t> always;
+
+  public:
+    /** Add a pattern. build() must be called after adding all patterns. */
+    void add(const string& pattern, size_t id)
+    {
+        if (pattern.empty())
+        {
+            always.push_back(id);
+            return;
+        }
+
+        int cur = 0;
+        for (char c : pattern)
+        {
+            auto it = nodes[cur].next.find(c);
+            if (it == nodes[cur].next.end())
+            {
+                nodes.push_back(node_t{});
+                it = nodes[cur].next.emplace(c, nodes.size() - 1).first;
+            }
+
+            cur = it->second;
+        }
+
+        nodes[cur].outputs.push_back(id);
+    }
+
+    /** Compute the fail links of the automaton */
+    void build()
+    {
+        std::vector<int> queue;
+        for (auto& child : nodes[0].next)
+            queue.push_back(child.second);
+
+        /* Breadth-first, so that the fail links of shorter prefixes are
+         * ready when they are needed */
+        for (size_t i = 0; i < queue.size(); i++)
+        {
+            int cur = queue[i];
+            for (auto& child : nodes[cur].next)
+            {
+                int fail = nodes[cur].fail;
+                while (fail && !nodes[fail].next.count(child.first))
+                    fail = nodes[fail].fail;
+
+                auto it = nodes[fail].next.find(child.first);
+                if (it != nodes[fail].next.end() && it->second != child.second)
+                    fail = it->second;
+
+                auto& node = nodes[child.second];
+                node.fail = fail;
+                node.outputs.insert(node.outputs.end(),
+                    nodes[fail].outputs.begin(), nodes[fail].outputs.end());
+                queue.push_back(child.second);
+            }
+        }
+    }
+
+    /** Call callback with the id of each pattern found in text. The same id
+     * may be reported multiple times. */
+    template<class Callback>
+    void find_all(const string& text, Callback callback) const
+    {
+        for (auto id : always)
+            callback(id);
+
+        int cur = 0;
+        for (char c : text)
+        {
+            auto it = nodes[cur].next.find(c);
+            while (cur && it == nodes[cur].next.end())
+            {
+                cur = nodes[cur].fail;
+                it = nodes[cur].next.find(c);
+            }
+
+            cur = (it == nodes[cur].next.end() ? 0 : it->second);
+            for (auto id : nodes[cur].outputs)
+                callback(id);
+        }
+    }
+};
+
 class wayfire_window_rules : public wf::plugin_interface_t
 {
-    using verification_func = std::function<bool(wayfire_view, std::string)>;
+    /* The view attribute a rule matches against */
+    enum rule_field_t
+    {
+        FIELD_TITLE  = 0,
+        FIELD_APP_ID = 1,
+        FIELD_TOTAL  = 2,
+    };
 
     struct verificator
     {
-        verification_func func;
+        rule_field_t field;
+        bool contains;
         std::string atom;
     };
 
     std::vector<verificator> verficators =
     {
-        {  [] (wayfire_view view, std::string match) -> bool
-            {
-                auto title = view->get_title();
-                return title.find(match) != std::string::npos;
-            },
-            "title contains"
-        },
-        { [] (wayfire_view view, std::string match) -> bool
-            {
-                auto title = view->get_title();
-                return title == match;
-            },
-            "title"
-        },
-        {  [] (wayfire_view view, std::string match) -> bool
-            {
-                auto app_id = view->get_app_id();
-                return app_id.find(match) != std::string::npos;
-            },
-            "app-id contains"
-        },
-        {  [] (wayfire_view view, std::string match) -> bool
-            {
-                auto app_id = view->get_app_id();
-                return app_id == match;
-            },
-            "app-id"
-        },
+        {FIELD_TITLE, true, "title contains"},
+        {FIELD_TITLE, false, "title"},
+        {FIELD_APP_ID, true, "app-id contains"},
+        {FIELD_APP_ID, false, "app-id"},
     };
 
     std::vector<std::string> events = {
@@ -101,18 +193,15 @@ class wayfire_window_rules : public wf::plugin_interface_t
 
     using action_func = std::function<void(wayfire_view view)>;
 
-    struct lambda_executor
-    {
-        verification_func verify;
-        std::string verification_string;
-        action_func action;
-    };
-
-    using rule_func = std::function<void(wayfire_view)>;
+    /* Rules which fail to parse are returned with an empty signal and no
+     * action, so all fields need defaults */
     struct rule
     {
         std::string signal;
-        std::function<void(wayfire_view)> func;
+        rule_field_t field = FIELD_TITLE;
+        bool contains = false;
+        std::string pattern;
+        action_func action;
     };
 
     rule parse_add_rule(std::string rule)
@@ -145,25 +234,25 @@ class wayfire_window_rules : public wf::plugin_interface_t
             }
         }
 
-        lambda_executor exec;
-        exec.verify = nullptr;
-        exec.action = nullptr;
-
+        bool found_verificator = false;
         for (const auto& pred : verficators)
         {
             if (starts_with(predicate, pred.atom))
             {
-                exec.verify = pred.func;
-                exec.verification_string =
+                result.field = pred.field;
+                result.contains = pred.contains;
+                result.pattern =
                     trim(predicate.substr(pred.atom.length(),
                                           predicate.length() - pred.atom.length()));
+                found_verificator = true;
                 break;
             }
         }
 
-        if (!exec.verify || !event.length())
+        if (!found_verificator || !event.length())
             return result;
 
+        action_func exec = nullptr;
         if (starts_with(action, "move"))
         {
             int x, y;
@@ -172,7 +261,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             if (t != 2)
                 return result;
 
-            exec.action = [x,y] (wayfire_view view) {
+            exec = [x,y] (wayfire_view view) {
                 auto og = view->get_output()->get_relative_geometry();
                 view->move(og.x + x, og.y + y);
             };
@@ -184,7 +273,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             if (t != 2 || w <= 0 || h <= 0)
                 return result;
 
-            exec.action = [w,h] (wayfire_view view) mutable {
+            exec = [w,h] (wayfire_view view) mutable {
                 auto screen_size = view->get_output()->get_screen_size();
                 if (w > 100000)
                     w = screen_size.width;
@@ -194,7 +283,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             };
         } else if (ends_with(action, "set maximized"))
         {
-            exec.action = [action] (wayfire_view view)
+            exec = [action] (wayfire_view view)
             {
                 uint32_t edges =
                     starts_with(action, "set") ? wf::TILED_EDGES_ALL : 0;
@@ -202,7 +291,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             };
         } else if (ends_with(action, "set fullscreen"))
         {
-            exec.action = [action] (wayfire_view view)
+            exec = [action] (wayfire_view view)
             {
                 view_fullscreen_signal data;
                 data.view = view;
@@ -217,7 +306,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
                 return result;
             a = std::max(std::min(1.0f, a), 0.1f); /* clamp a in range [0.1f, 1.0f] */
 
-            exec.action = [a] (wayfire_view view)
+            exec = [a] (wayfire_view view)
             {
                 wf::view_2D *transformer;
 
@@ -231,40 +320,132 @@ class wayfire_window_rules : public wf::plugin_interface_t
                     view->damage();
                 }
             };
+        } else if (starts_with(action, "set occluded_frame_rate"))
+        {
+            int rate;
+            int t = std::sscanf(action.c_str(), "set occluded_frame_rate %d", &rate);
+            if (t != 1 || rate < -1)
+                return result;
+
+            exec = [rate] (wayfire_view view)
+            {
+                view->get_data_safe<wf::occluded_frame_rate_t>()->frame_rate = rate;
+            };
         }
 
 
-        if (!exec.action)
+        if (!exec)
             return result;
 
         result.signal = event;
-        result.func = [exec] (wayfire_view view)
-        {
-            if (exec.verify(view, exec.verification_string))
-                exec.action(view);
-        };
+        result.action = exec;
 
         return result;
     }
 
-    wf::signal_callback_t created, maximized, fullscreened;
+    /**
+     * The rules for a single event, indexed by the text they match, so that
+     * matching cost does not depend on the number of rules.
+     */
+    struct rule_index_t
+    {
+        /* Actions, in the order of the rules in the config */
+        std::vector<action_func> actions;
+        std::unordered_map<std::string, std::vector<size_t>> exact[FIELD_TOTAL];
+        substring_index_t contains[FIELD_TOTAL];
 
-    std::map<std::string, std::vector<rule_func>> rules_list;
+        void add(const rule& r)
+        {
+            size_t id = actions.size();
+            actions.push_back(r.action);
+            if (r.contains)
+            {
+                contains[r.field].add(r.pattern, id);
+            } else
+            {
+                exact[r.field][r.pattern].push_back(id);
+            }
+        }
 
-    public:
-    void init()
+        void build()
+        {
+            for (auto& index : contains)
+                index.build();
+        }
+
+        void apply(wayfire_view view) const
+        {
+            std::string fields[FIELD_TOTAL];
+            fields[FIELD_TITLE] = view->get_title();
+            fields[FIELD_APP_ID] = view->get_app_id();
+
+            std::vector<size_t> matched;
+            for (int i = 0; i < FIELD_TOTAL; i++)
+            {
+                auto it = exact[i].find(fields[i]);
+                if (it != exact[i].end())
+                    matched.insert(matched.end(), it->second.begin(), it->second.end());
+
+                contains[i].find_all(fields[i],
+                    [&] (size_t id) { matched.push_back(id); });
+            }
+
+            /* Run the actions in the order of the rules in the config */
+            std::sort(matched.begin(), matched.end());
+            matched.erase(std::unique(matched.begin(), matched.end()), matched.end());
+            for (auto id : matched)
+                actions[id](view);
+        }
+    };
+
+    /* Parsed rules, by their text in the config, so that on config reload only
+     * new or changed rules need to be parsed again */
+    std::map<std::string, rule> parsed_rules;
+    std::map<std::string, rule_index_t> rules_index;
+
+    void load_rules()
     {
+        std::map<std::string, rule> current_rules;
+        std::map<std::string, rule_index_t> index;
+
         auto section = wf::get_core().config.get_section("window-rules");
         for (auto opt : section->get_registered_options())
         {
-            auto rule = parse_add_rule(opt->get_value_str());
-            rules_list[rule.signal].push_back(rule.func);
+            auto text = opt->get_value_str();
+            auto it = parsed_rules.find(text);
+            auto r = (it != parsed_rules.end() ? it->second : parse_add_rule(text));
+
+            current_rules[text] = r;
+            if (r.action)
+                index[r.signal].add(r);
         }
 
+        for (auto& ev : index)
+            ev.second.build();
+
+        parsed_rules = std::move(current_rules);
+        rules_index = std::move(index);
+    }
+
+    void apply_rules(std::string event, wayfire_view view)
+    {
+        auto it = rules_index.find(event);
+        if (it != rules_index.end())
+            it->second.apply(view);
+    }
+
+    wf::signal_callback_t created, maximized, fullscreened, reload_config;
+
+    public:
+    void init()
+    {
+        load_rules();
+        reload_config = [=] (wf::signal_data_t*) { load_rules(); };
+        wf::get_core().connect_signal("reload-config", &reload_config);
+
         created = [=] (wf::signal_data_t *data)
         {
-            for (const auto& rule : rules_list["created"])
-                rule(get_signaled_view(data));
+            apply_rules("created", get_signaled_view(data));
         };
         output->connect_signal("map-view", &created);
 
@@ -276,8 +457,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             if (conv->edges != wf::TILED_EDGES_ALL)
                 return;
 
-            for (const auto& rule : rules_list["maximized"])
-                rule(conv->view);
+            apply_rules("maximized", conv->view);
         };
         output->connect_signal("view-maximized", &maximized);
 
@@ -289,8 +469,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
             if (!conv->state || conv->carried_out)
                 return;
 
-            for (const auto& rule : rules_list["fullscreened"])
-                rule(conv->view);
+            apply_rules("fullscreened", conv->view);
             conv->carried_out = true;
         };
         output->connect_signal("view-fullscreen", &fullscreened);
@@ -298,6 +477,7 @@ class wayfire_window_rules : public wf::plugin_interface_t
 
     void fini()
     {
+        wf::get_core().disconnect_signal("reload-config", &reload_config);
         output->disconnect_signal("map-view", &created);
         output->disconnect_signal("view-maximized", &maximized);
         output->disconnect_signal("view-fullscreen", &fullscreened);
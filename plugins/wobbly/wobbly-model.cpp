@@ -0,0 +1,587 @@
+/*
+ * Copyright © 2005 Novell, Inc.
+ * Copyright © 2014 Scott Moreau
+ *
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * Novell, Inc. not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior permission.
+ * Novell, Inc. makes no representations about the suitability of this
+ * software for any purpose. It is provided "as is" without express or
+ * implied warranty.
+ *
+ * NOVELL, INC. DISCLAIMS ALL WARRANTIES WITH REGARD TO THIS SOFTWARE,
+ * INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS, IN
+ * NO EVENT SHALL NOVELL, INC. BE LIABLE FOR ANY SPECIAL, INDIRECT OR
+ * CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM LOSS
+ * OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT,
+ * NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION
+ * WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ * Author: David Reveman <davidr@novell.com>
+ *         Scott Moreau <oreaus@gmail.com>
+ */
+
+/*
+ * Spring model implemented by Kristian Hogsberg.
+ */
+
+#include <algorithm>
+#include <array>
+#include <climits>
+#include <cmath>
+
+#include "wobbly-model.hpp"
+
+namespace
+{
+constexpr int GRID_WIDTH = 4;
+constexpr int GRID_HEIGHT = 4;
+constexpr int NUM_OBJECTS = GRID_WIDTH * GRID_HEIGHT;
+
+constexpr int WobblyInitial = (1 << 0);
+constexpr int WobblyForce = (1 << 1);
+constexpr int WobblyVelocity = (1 << 2);
+
+/* 0 for the objects in the first column, which have no spring to the left */
+const auto horizontal_spring_mask = [] ()
+{
+    std::array<float, NUM_OBJECTS> mask;
+    for (int i = 0; i < NUM_OBJECTS; i++)
+        mask[i] = (i % GRID_WIDTH) ? 1.0f : 0.0f;
+
+    return mask;
+} ();
+
+/**
+ * The weights of the four control points of a cubic bezier curve, evaluated
+ * at the points of a grid with the given number of cells.
+ */
+struct bezier_basis_t
+{
+    int cells = -1;
+    /* weight[i][p] is the weight of control point i at grid point p */
+    std::vector<float> weight[4];
+
+    void update(int new_cells)
+    {
+        if (new_cells == cells)
+            return;
+
+        cells = new_cells;
+        for (auto& w : weight)
+            w.resize(cells + 1);
+
+        for (int p = 0; p <= cells; p++)
+        {
+            float u = 1.0f * p / cells;
+            weight[0][p] = (1 - u) * (1 - u) * (1 - u);
+            weight[1][p] = 3 * u * (1 - u) * (1 - u);
+            weight[2][p] = 3 * u * u * (1 - u);
+            weight[3][p] = u * u * u;
+        }
+    }
+};
+}
+
+/**
+ * The spring model of a surface.
+ *
+ * The objects are stored as a structure of arrays, row by row. Springs
+ * connect each object to its right and bottom neighbours, so they are not
+ * stored at all, only their rest lengths. Immobile objects are masked out
+ * arithmetically, so that the solver loops have no branches and can be
+ * vectorized by the compiler.
+ */
+struct wobbly_window_t
+{
+    float px[NUM_OBJECTS], py[NUM_OBJECTS];
+    float vx[NUM_OBJECTS], vy[NUM_OBJECTS];
+    /* 1 for objects which move freely, 0 for immobile objects */
+    float mobile[NUM_OBJECTS];
+
+    /* The index of the anchor object, or -1 */
+    int anchor = -1;
+
+    /* The rest lengths of the horizontal and vertical springs */
+    float hpad, vpad;
+
+    float steps = 0;
+    float tlx, tly, brx, bry;
+
+    int wobbly = 0;
+    int grabbed = 0;
+    int grab_dx = 0, grab_dy = 0;
+
+    bezier_basis_t basis_u, basis_v;
+};
+
+namespace
+{
+bool model_is_immobile(wobbly_window_t *ww, int object)
+{
+    return ww->mobile[object] == 0.0f;
+}
+
+void model_set_immobile(wobbly_window_t *ww, int object, bool immobile)
+{
+    ww->mobile[object] = immobile ? 0.0f : 1.0f;
+}
+
+void model_calc_bounds(wobbly_window_t *ww)
+{
+    ww->tlx = ww->tly = SHRT_MAX;
+    ww->brx = ww->bry = SHRT_MIN;
+
+    for (int i = 0; i < NUM_OBJECTS; i++)
+    {
+        ww->tlx = std::min(ww->tlx, ww->px[i]);
+        ww->tly = std::min(ww->tly, ww->py[i]);
+        ww->brx = std::max(ww->brx, ww->px[i]);
+        ww->bry = std::max(ww->bry, ww->py[i]);
+    }
+}
+
+void model_set_anchor(wobbly_window_t *ww, int object, float x, float y)
+{
+    if (ww->anchor >= 0)
+        model_set_immobile(ww, ww->anchor, false);
+
+    ww->anchor = object;
+    ww->px[object] = x;
+    ww->py[object] = y;
+    model_set_immobile(ww, object, true);
+}
+
+void model_set_middle_anchor(wobbly_window_t *ww, int x, int y,
+    int width, int height)
+{
+    float gx = ((GRID_WIDTH - 1) / 2 * width) / (float)(GRID_WIDTH - 1);
+    float gy = ((GRID_HEIGHT - 1) / 2 * height) / (float)(GRID_HEIGHT - 1);
+
+    model_set_anchor(ww,
+        GRID_WIDTH * ((GRID_HEIGHT - 1) / 2) + (GRID_WIDTH - 1) / 2,
+        x + gx, y + gy);
+}
+
+void model_set_top_anchor(wobbly_window_t *ww, int x, int y, int width)
+{
+    float gx = ((GRID_WIDTH - 1) / 2 * width) / (float)(GRID_WIDTH - 1);
+    model_set_anchor(ww, (GRID_WIDTH - 1) / 2, x + gx, y);
+}
+
+void model_init_objects(wobbly_window_t *ww, int x, int y,
+    int width, int height)
+{
+    float gw = GRID_WIDTH - 1;
+    float gh = GRID_HEIGHT - 1;
+
+    int i = 0;
+    for (int grid_y = 0; grid_y < GRID_HEIGHT; grid_y++)
+    {
+        for (int grid_x = 0; grid_x < GRID_WIDTH; grid_x++)
+        {
+            ww->px[i] = x + (grid_x * width) / gw;
+            ww->py[i] = y + (grid_y * height) / gh;
+            ww->vx[i] = ww->vy[i] = 0;
+            ww->mobile[i] = 1;
+            i++;
+        }
+    }
+
+    ww->anchor = -1;
+    model_set_middle_anchor(ww, x, y, width, height);
+}
+
+void model_init_springs(wobbly_window_t *ww, int width, int height)
+{
+    ww->hpad = ((float) width) / (GRID_WIDTH - 1);
+    ww->vpad = ((float) height) / (GRID_HEIGHT - 1);
+}
+
+/**
+ * Advance the model by the given time.
+ *
+ * @return The wobbly flags, i.e whether the model is still moving.
+ */
+int model_step(wobbly_window_t *ww, float friction, float k, float time)
+{
+    ww->steps += time / 15.0f;
+    int steps = std::floor(ww->steps);
+    ww->steps -= steps;
+
+    if (!steps)
+        return WobblyInitial;
+
+    float velocity_sum = 0.0f;
+    float force_sum = 0.0f;
+
+    /* Half the extension of the spring ending at each object, from the
+     * left (dh) and from above (dv). The padding at the end stands for the
+     * springs beyond the last row and column, which don't exist. */
+    float dhx[NUM_OBJECTS + 1] = {0}, dhy[NUM_OBJECTS + 1] = {0};
+    float dvx[NUM_OBJECTS + GRID_WIDTH] = {0};
+    float dvy[NUM_OBJECTS + GRID_WIDTH] = {0};
+    float fx[NUM_OBJECTS], fy[NUM_OBJECTS];
+
+    for (int step = 0; step < steps; step++)
+    {
+        for (int i = 1; i < NUM_OBJECTS; i++)
+        {
+            float mask = horizontal_spring_mask[i];
+            dhx[i] = 0.5f * (ww->px[i] - ww->px[i - 1] - ww->hpad) * mask;
+            dhy[i] = 0.5f * (ww->py[i] - ww->py[i - 1]) * mask;
+        }
+
+        for (int i = GRID_WIDTH; i < NUM_OBJECTS; i++)
+        {
+            dvx[i] = 0.5f * (ww->px[i] - ww->px[i - GRID_WIDTH]);
+            dvy[i] = 0.5f * (ww->py[i] - ww->py[i - GRID_WIDTH] - ww->vpad);
+        }
+
+        /* Each spring pulls both of its ends towards each other */
+        for (int i = 0; i < NUM_OBJECTS; i++)
+        {
+            fx[i] = k * (dhx[i + 1] - dhx[i] + dvx[i + GRID_WIDTH] - dvx[i]);
+            fy[i] = k * (dhy[i + 1] - dhy[i] + dvy[i + GRID_WIDTH] - dvy[i]);
+        }
+
+        const float mass = WOBBLY_MASS;
+        for (int i = 0; i < NUM_OBJECTS; i++)
+        {
+            fx[i] = (fx[i] - friction * ww->vx[i]) * ww->mobile[i];
+            fy[i] = (fy[i] - friction * ww->vy[i]) * ww->mobile[i];
+
+            ww->vx[i] = (ww->vx[i] + fx[i] / mass) * ww->mobile[i];
+            ww->vy[i] = (ww->vy[i] + fy[i] / mass) * ww->mobile[i];
+
+            ww->px[i] += ww->vx[i];
+            ww->py[i] += ww->vy[i];
+        }
+
+        for (int i = 0; i < NUM_OBJECTS; i++)
+        {
+            velocity_sum += std::abs(ww->vx[i]) + std::abs(ww->vy[i]);
+            force_sum += std::abs(fx[i]) + std::abs(fy[i]);
+        }
+    }
+
+    model_calc_bounds(ww);
+
+    int wobbly = 0;
+    if (velocity_sum > 0.5f)
+        wobbly |= WobblyVelocity;
+    if (force_sum > 20.0f)
+        wobbly |= WobblyForce;
+
+    return wobbly;
+}
+
+int model_find_nearest_object(wobbly_window_t *ww, float x, float y)
+{
+    int object = 0;
+    float min_distance = 0;
+    for (int i = 0; i < NUM_OBJECTS; i++)
+    {
+        float dx = ww->px[i] - x;
+        float dy = ww->py[i] - y;
+        float distance = dx * dx + dy * dy;
+        if (i == 0 || distance < min_distance)
+        {
+            min_distance = distance;
+            object = i;
+        }
+    }
+
+    return object;
+}
+
+/** Push the neighbours of the given object, as if it had been pulled */
+void model_push_neighbours(wobbly_window_t *ww, int object)
+{
+    int grid_x = object % GRID_WIDTH;
+    int grid_y = object / GRID_WIDTH;
+
+    if (grid_x + 1 < GRID_WIDTH)
+        ww->vx[object + 1] -= ww->hpad * 0.05f;
+    if (grid_x > 0)
+        ww->vx[object - 1] += ww->hpad * 0.05f;
+    if (grid_y + 1 < GRID_HEIGHT)
+        ww->vy[object + GRID_WIDTH] -= ww->vpad * 0.05f;
+    if (grid_y > 0)
+        ww->vy[object - GRID_WIDTH] += ww->vpad * 0.05f;
+}
+
+const int corner_objects[] = {
+    0, GRID_WIDTH - 1, GRID_WIDTH * (GRID_HEIGHT - 1), NUM_OBJECTS - 1,
+};
+
+void model_adjust_corners(wobbly_window_t *ww, int x, int y,
+    int width, int height, bool make_immobile)
+{
+    const int corner_x[] = {x, x + width, x, x + width};
+    const int corner_y[] = {y, y, y + height, y + height};
+
+    for (int i = 0; i < 4; i++)
+    {
+        ww->px[corner_objects[i]] = corner_x[i];
+        ww->py[corner_objects[i]] = corner_y[i];
+        model_set_immobile(ww, corner_objects[i], make_immobile);
+    }
+
+    if (ww->anchor < 0)
+        ww->anchor = 0;
+}
+
+/** @return Whether any of the corners was immobile */
+bool model_remove_edge_anchors(wobbly_window_t *ww)
+{
+    bool result = false;
+    for (int object : corner_objects)
+    {
+        if (object != ww->anchor)
+        {
+            result |= model_is_immobile(ww, object);
+            model_set_immobile(ww, object, false);
+        }
+    }
+
+    return result;
+}
+}
+
+wobbly_surface::wobbly_surface() = default;
+wobbly_surface::~wobbly_surface() = default;
+
+void wobbly_prepare_paint(struct wobbly_surface *surface, int msSinceLastPaint)
+{
+    auto ww = surface->ww.get();
+    float friction = wobbly_settings_get_friction();
+    float spring_k = wobbly_settings_get_spring_k();
+
+    if (ww->wobbly & (WobblyInitial | WobblyVelocity | WobblyForce))
+    {
+        ww->wobbly = model_step(ww, friction, spring_k,
+            (ww->wobbly & WobblyVelocity) ? msSinceLastPaint : 16);
+
+        if (ww->wobbly)
+        {
+            /* The model may have been moved by a grab or resize even if no
+             * step was done */
+            model_calc_bounds(ww);
+        } else
+        {
+            surface->x = ww->tlx;
+            surface->y = ww->tly;
+            surface->synced = 1;
+        }
+    }
+}
+
+void wobbly_done_paint(struct wobbly_surface *surface)
+{
+    auto ww = surface->ww.get();
+    if (ww->wobbly)
+    {
+        surface->x = ww->tlx;
+        surface->y = ww->tly;
+    }
+}
+
+void wobbly_add_geometry(struct wobbly_surface *surface)
+{
+    auto ww = surface->ww.get();
+    if (!ww->wobbly)
+        return;
+
+    ww->basis_u.update(surface->x_cells);
+    ww->basis_v.update(surface->y_cells);
+
+    int iw = surface->x_cells + 1;
+    int ih = surface->y_cells + 1;
+    surface->vertices.resize(2 * iw * ih);
+    surface->vertices_dirty = true;
+
+    float *v = surface->vertices.data();
+    for (int y = 0; y < ih; y++)
+    {
+        /* Evaluate the columns of the patch at this row first, which leaves
+         * a single bezier curve to evaluate along the row */
+        float cx[GRID_WIDTH], cy[GRID_WIDTH];
+        for (int i = 0; i < GRID_WIDTH; i++)
+        {
+            cx[i] = cy[i] = 0;
+            for (int j = 0; j < GRID_HEIGHT; j++)
+            {
+                cx[i] += ww->basis_v.weight[j][y] * ww->px[j * GRID_WIDTH + i];
+                cy[i] += ww->basis_v.weight[j][y] * ww->py[j * GRID_WIDTH + i];
+            }
+        }
+
+        const float *w0 = ww->basis_u.weight[0].data();
+        const float *w1 = ww->basis_u.weight[1].data();
+        const float *w2 = ww->basis_u.weight[2].data();
+        const float *w3 = ww->basis_u.weight[3].data();
+        for (int x = 0; x < iw; x++)
+        {
+            v[2 * x] = w0[x] * cx[0] + w1[x] * cx[1] + w2[x] * cx[2] +
+                w3[x] * cx[3];
+            v[2 * x + 1] = w0[x] * cy[0] + w1[x] * cy[1] + w2[x] * cy[2] +
+                w3[x] * cy[3];
+        }
+
+        v += 2 * iw;
+    }
+}
+
+void wobbly_resize(struct wobbly_surface *surface, int width, int height)
+{
+    auto ww = surface->ww.get();
+
+    surface->synced = 0;
+    ww->wobbly |= WobblyInitial;
+
+    model_init_springs(ww, width, height);
+
+    ww->grab_dx = (ww->grab_dx * width) / surface->width;
+    ww->grab_dy = (ww->grab_dy * height) / surface->height;
+
+    surface->width = width;
+    surface->height = height;
+}
+
+void wobbly_move_notify(struct wobbly_surface *surface, int x, int y)
+{
+    auto ww = surface->ww.get();
+    if (ww->grabbed && ww->anchor >= 0)
+    {
+        ww->px[ww->anchor] = x + ww->grab_dx;
+        ww->py[ww->anchor] = y + ww->grab_dy;
+
+        ww->wobbly |= WobblyInitial;
+        surface->synced = 0;
+    }
+}
+
+void wobbly_slight_wobble(struct wobbly_surface *surface)
+{
+    auto ww = surface->ww.get();
+    int center = model_find_nearest_object(ww,
+        surface->x + surface->width / 2, surface->y + surface->height / 2);
+
+    model_push_neighbours(ww, center);
+    ww->wobbly |= WobblyInitial;
+}
+
+void wobbly_set_top_anchor(struct wobbly_surface *surface,
+    int x, int y, int w, int h)
+{
+    (void)h;
+    model_set_top_anchor(surface->ww.get(), x, y, w);
+}
+
+void wobbly_grab_notify(struct wobbly_surface *surface, int x, int y)
+{
+    auto ww = surface->ww.get();
+
+    int object = model_find_nearest_object(ww, x, y);
+    model_set_anchor(ww, object, ww->px[object], ww->py[object]);
+    ww->grab_dx = ww->px[object] - x;
+    ww->grab_dy = ww->py[object] - y;
+    ww->grabbed = 1;
+
+    model_push_neighbours(ww, object);
+    ww->wobbly |= WobblyInitial;
+}
+
+void wobbly_ungrab_notify(struct wobbly_surface *surface)
+{
+    auto ww = surface->ww.get();
+    if (ww->grabbed)
+    {
+        if (ww->anchor >= 0)
+            model_set_immobile(ww, ww->anchor, false);
+
+        ww->anchor = -1;
+        ww->wobbly |= WobblyInitial;
+
+        surface->synced = 0;
+        ww->grabbed = 0;
+    }
+}
+
+int wobbly_init(struct wobbly_surface *surface)
+{
+    surface->ww = std::make_unique<wobbly_window_t>();
+
+    auto ww = surface->ww.get();
+    model_init_objects(ww, surface->x, surface->y,
+        surface->width, surface->height);
+    model_init_springs(ww, surface->width, surface->height);
+    model_calc_bounds(ww);
+
+    return 1;
+}
+
+void wobbly_force_geometry(struct wobbly_surface *surface,
+    int x, int y, int w, int h)
+{
+    auto ww = surface->ww.get();
+    if (!ww->grabbed && ww->anchor >= 0)
+    {
+        model_set_immobile(ww, ww->anchor, false);
+        ww->anchor = -1;
+    }
+
+    surface->x = x;
+    surface->y = y;
+    surface->width = w;
+    surface->height = h;
+    surface->synced = 0;
+
+    model_init_springs(ww, w, h);
+    model_adjust_corners(ww, x, y, w, h, true);
+
+    ww->wobbly |= WobblyInitial;
+}
+
+void wobbly_unenforce_geometry(struct wobbly_surface *surface)
+{
+    auto ww = surface->ww.get();
+    if (model_remove_edge_anchors(ww))
+    {
+        if (ww->anchor < 0 || !model_is_immobile(ww, ww->anchor))
+        {
+            model_set_middle_anchor(ww, surface->x, surface->y,
+                surface->width, surface->height);
+        }
+
+        model_init_springs(ww, surface->width, surface->height);
+    }
+
+    ww->wobbly |= WobblyInitial;
+}
+
+void wobbly_translate(struct wobbly_surface *surface, int dx, int dy)
+{
+    auto ww = surface->ww.get();
+    for (int i = 0; i < NUM_OBJECTS; i++)
+    {
+        ww->px[i] += dx;
+        ww->py[i] += dy;
+    }
+
+    ww->tlx += dx;
+    ww->tly += dy;
+    ww->brx += dx;
+    ww->bry += dy;
+}
+
+struct wobbly_rect wobbly_boundingbox(struct wobbly_surface *surface)
+{
+    auto ww = surface->ww.get();
+    return {ww->tlx, ww->tly, ww->brx, ww->bry};
+}
@@ -5,9 +5,11 @@
  *
  **************************************************************************/
 
-#include <stdio.h>
+#ifndef WOBBLY_MODEL_HPP
+#define WOBBLY_MODEL_HPP
 
-#include <GLES2/gl2.h>
+#include <memory>
+#include <vector>
 
 #define MINIMAL_FRICTION 0.1
 #define MAXIMAL_FRICTION 10.0
@@ -18,15 +20,27 @@
 double wobbly_settings_get_friction();
 double wobbly_settings_get_spring_k();
 
+/* The spring model of a surface, internal to wobbly-model.cpp */
+struct wobbly_window_t;
+
 struct wobbly_surface
 {
-   void *ww;
-   int x, y, width, height;
-   int x_cells, y_cells;
-   int grabbed, synced;
-   int vertex_count;
+    std::unique_ptr<wobbly_window_t> ww;
+    int x, y, width, height;
+    int x_cells, y_cells;
+    int grabbed, synced;
+
+    /**
+     * The positions of the (x_cells + 1) * (y_cells + 1) points of the
+     * deformed surface, row by row, as x, y pairs. Empty until the model
+     * has been deformed for the first time.
+     */
+    std::vector<float> vertices;
+    /** Set whenever vertices change, cleared by the renderer after upload */
+    bool vertices_dirty = false;
 
-   GLfloat *v, *uv;
+    wobbly_surface();
+    ~wobbly_surface();
 };
 
 struct wobbly_rect
@@ -36,7 +50,6 @@ struct wobbly_rect
 };
 
 int  wobbly_init(struct wobbly_surface *surface);
-void wobbly_fini(struct wobbly_surface *surface);
 void wobbly_set_top_anchor(struct wobbly_surface *surface,
     int x, int y, int w, int h);
 
@@ -56,3 +69,5 @@ void wobbly_force_geometry(struct wobbly_surface *surface,
 void wobbly_unenforce_geometry(struct wobbly_surface *surface);
 
 void wobbly_translate(struct wobbly_surface *surface, int dx, int dy);
+
+#endif /* end of include guard: WOBBLY_MODEL_HPP */
@@ -4,12 +4,10 @@
 #include <wayfire/view-transform.hpp>
 #include <wayfire/workspace-manager.hpp>
 #include <wayfire/render-manager.hpp>
+#include <wayfire/nonstd/safe-list.hpp>
+#include <map>
 
-extern "C"
-{
-#include "wobbly.h"
-}
-
+#include "wobbly-model.hpp"
 #include "wobbly-signal.hpp"
 
 namespace wobbly_graphics
@@ -44,6 +42,12 @@ void main()
 }
 
 OpenGL::program_t program;
+struct
+{
+    OpenGL::attrib_t position, uv_position;
+    OpenGL::uniform_t mvp;
+} handles;
+
 int times_loaded = 0;
 
 void load_program()
@@ -53,87 +57,149 @@ void load_program()
 
     OpenGL::render_begin();
     program.compile(vertex_source, frag_source);
+    handles.position = program.get_attrib("position");
+    handles.uv_position = program.get_attrib("uvPosition");
+    handles.mvp = program.get_uniform("MVP");
     OpenGL::render_end();
 }
 
-void destroy_program()
-{
-    if (--times_loaded == 0)
-    {
-        OpenGL::render_begin();
-        program.free_resources();
-        OpenGL::render_end();
-    }
-}
-
 /**
- * Enumerate the needed triangles for rendering the model
+ * The texture coordinates and the triangles of a mesh with the given number
+ * of cells, which are the same for all wobbly views.
  */
-void prepare_geometry(wobbly_surface *model, wf::geometry_t src_box,
-    std::vector<float>& vert, std::vector<float>& uv)
+struct grid_buffers_t
 {
-    float x = src_box.x, y = src_box.y, w = src_box.width, h = src_box.height;
-    std::vector<int> idx;
+    GLuint uv = 0;
+    GLuint indices = 0;
+    GLsizei index_count = 0;
+};
 
-    int per_row = model->x_cells + 1;
+std::map<std::pair<int, int>, grid_buffers_t> grid_buffers;
 
-    for (int j = 0; j < model->y_cells; j++)
+/* Requires bound opengl context */
+const grid_buffers_t& get_grid_buffers(int x_cells, int y_cells)
+{
+    auto& grid = grid_buffers[{x_cells, y_cells}];
+    if (grid.indices)
+        return grid;
+
+    int per_row = x_cells + 1;
+    std::vector<float> uv;
+    for (int j = 0; j <= y_cells; j++)
     {
-        for (int i = 0; i < model->x_cells; i++)
+        for (int i = 0; i <= x_cells; i++)
         {
-            idx.push_back(i * per_row + j);
-            idx.push_back((i + 1) * per_row + j + 1);
-            idx.push_back(i * per_row + j + 1);
-
-            idx.push_back(i * per_row + j);
-            idx.push_back((i + 1) * per_row + j);
-            idx.push_back((i + 1) * per_row + j + 1);
+            uv.push_back(1.0f * i / x_cells);
+            uv.push_back(1.0f - 1.0f * j / y_cells);
         }
     }
 
-    if (!model->v || !model->uv)
+    std::vector<GLuint> idx;
+    for (int j = 0; j < y_cells; j++)
     {
-        for (auto id : idx)
+        for (int i = 0; i < x_cells; i++)
         {
-            float tile_w = w / model->x_cells;
-            float tile_h = h / model->y_cells;
+            GLuint id = j * per_row + i;
+            idx.push_back(id);
+            idx.push_back(id + per_row + 1);
+            idx.push_back(id + 1);
+
+            idx.push_back(id);
+            idx.push_back(id + per_row);
+            idx.push_back(id + per_row + 1);
+        }
+    }
 
-            int i = id / per_row;
-            int j = id % per_row;
+    GL_CALL(glGenBuffers(1, &grid.uv));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, grid.uv));
+    GL_CALL(glBufferData(GL_ARRAY_BUFFER, uv.size() * sizeof(float),
+        uv.data(), GL_STATIC_DRAW));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
 
-            vert.push_back(i * tile_w + x);
-            vert.push_back(j * tile_h + y);
+    GL_CALL(glGenBuffers(1, &grid.indices));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid.indices));
+    GL_CALL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint),
+        idx.data(), GL_STATIC_DRAW));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
 
-            uv.push_back(1.0f * i / model->x_cells);
-            uv.push_back(1.0f - 1.0f * j / model->y_cells);
-        }
-    } else
+    grid.index_count = idx.size();
+    return grid;
+}
+
+void destroy_program()
+{
+    if (--times_loaded == 0)
     {
-        for (auto i : idx)
+        OpenGL::render_begin();
+        program.free_resources();
+        for (auto& grid : grid_buffers)
         {
-            vert.push_back(model->v[2 * i]);
-            vert.push_back(model->v[2 * i + 1]);
+            GL_CALL(glDeleteBuffers(1, &grid.second.uv));
+            GL_CALL(glDeleteBuffers(1, &grid.second.indices));
+        }
+
+        grid_buffers.clear();
+        OpenGL::render_end();
+    }
+}
+
+/**
+ * Fill the vertices of an undeformed mesh covering the given box.
+ */
+void prepare_flat_geometry(wobbly_surface *model, wf::geometry_t src_box,
+    std::vector<float>& vert)
+{
+    float tile_w = 1.0f * src_box.width / model->x_cells;
+    float tile_h = 1.0f * src_box.height / model->y_cells;
 
-            uv.push_back(model->uv[2 * i]);
-            uv.push_back(model->uv[2 * i + 1]);
+    for (int j = 0; j <= model->y_cells; j++)
+    {
+        for (int i = 0; i <= model->x_cells; i++)
+        {
+            vert.push_back(i * tile_w + src_box.x);
+            vert.push_back(j * tile_h + src_box.y);
         }
     }
 }
 
+/**
+ * Upload the vertices of a mesh to the given buffer, which is created if
+ * it doesn't exist yet. Requires bound opengl context.
+ */
+void upload_vertices(GLuint& vbo, const std::vector<float>& vert)
+{
+    if (!vbo)
+        GL_CALL(glGenBuffers(1, &vbo));
+
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+    GL_CALL(glBufferData(GL_ARRAY_BUFFER, vert.size() * sizeof(float),
+        vert.data(), GL_STREAM_DRAW));
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+}
+
 /* Requires bound opengl context */
-void render_triangles(wf::texture_t tex, glm::mat4 mat, float *pos, float *uv, int cnt)
+void render_mesh(wf::texture_t tex, glm::mat4 mat, GLuint vbo,
+    int x_cells, int y_cells)
 {
+    auto& grid = get_grid_buffers(x_cells, y_cells);
+
     program.use(tex.type);
     program.set_active_texture(tex);
 
-    program.attrib_pointer("position", 2, 0, pos);
-    program.attrib_pointer("uvPosition", 2, 0, uv);
-    program.uniformMatrix4f("MVP", mat);
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+    program.attrib_pointer(handles.position, 2, 0, nullptr);
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, grid.uv));
+    program.attrib_pointer(handles.uv_position, 2, 0, nullptr);
+    GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+    program.uniformMatrix4f(handles.mvp, mat);
 
     GL_CALL(glEnable(GL_BLEND));
     GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
 
-    GL_CALL(glDrawArrays (GL_TRIANGLES, 0, 3 * cnt));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, grid.indices));
+    GL_CALL(glDrawElements(GL_TRIANGLES, grid.index_count,
+        GL_UNSIGNED_INT, nullptr));
+    GL_CALL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0));
     GL_CALL(glDisable(GL_BLEND));
 
     program.deactivate();
@@ -147,19 +213,16 @@ namespace wobbly_settings
     wf::option_wrapper_t<int> resolution{"wobbly/grid_resolution"};
 };
 
-extern "C"
+double wobbly_settings_get_friction()
 {
-    double wobbly_settings_get_friction()
-    {
-        return wf::clamp((double) wobbly_settings::friction,
-            MINIMAL_FRICTION, MAXIMAL_FRICTION);
-    }
+    return wf::clamp((double) wobbly_settings::friction,
+        MINIMAL_FRICTION, MAXIMAL_FRICTION);
+}
 
-    double wobbly_settings_get_spring_k()
-    {
-        return wf::clamp((double) wobbly_settings::spring_k,
-            MINIMAL_SPRING_K, MAXIMAL_SPRING_K);
-    }
+double wobbly_settings_get_spring_k()
+{
+    return wf::clamp((double) wobbly_settings::spring_k,
+        MINIMAL_SPRING_K, MAXIMAL_SPRING_K);
 }
 
 namespace wf
@@ -464,10 +527,44 @@ class wobbly_state_free_t : public iwobbly_state_t
 };
 }
 
+class wf_wobbly;
+
+/**
+ * Updates the wobbly views on an output at the start of each frame.
+ *
+ * The models of all views are advanced together, and then the meshes of
+ * all views are uploaded to the GPU in a single GL pass, instead of each
+ * view having its own frame hook.
+ */
+class wobbly_output_batch_t : public wf::custom_data_t
+{
+    wf::output_t *output = nullptr;
+    wf::safe_list_t<wf_wobbly*> views;
+    wf::effect_hook_t pre_hook = [=] () { update(); };
+
+    void update();
+
+  public:
+    void add(wf::output_t *wo, wf_wobbly *view)
+    {
+        this->output = wo;
+        if (views.size() == 0)
+            output->render->add_effect(&pre_hook, wf::OUTPUT_EFFECT_PRE);
+
+        views.push_back(view);
+    }
+
+    void remove(wf_wobbly *view)
+    {
+        views.remove_all(view);
+        if (views.size() == 0)
+            output->render->rem_effect(&pre_hook);
+    }
+};
+
 class wf_wobbly : public wf::view_transformer_t
 {
     wayfire_view view;
-    wf::effect_hook_t pre_hook;
 
     wf::signal_callback_t view_removed = [=] (wf::signal_data_t *) {
         destroy_self();
@@ -499,15 +596,28 @@ class wf_wobbly : public wf::view_transformer_t
         state->translate_model(old_geometry.x - new_geometry.x,
             old_geometry.y - new_geometry.y);
 
-        sig->output->render->rem_effect(&pre_hook);
-        view->get_output()->render->add_effect(&pre_hook,
-            wf::OUTPUT_EFFECT_PRE);
+        set_output(view->get_output());
     };
 
     std::unique_ptr<wobbly_surface> model;
     std::unique_ptr<wf::iwobbly_state_t> state;
     uint32_t last_frame;
 
+    /* The vertices of the mesh, kept on the GPU between frames */
+    GLuint vertex_buffer = 0;
+
+    /* The output whose batch updates this view */
+    wf::output_t *output = nullptr;
+    void set_output(wf::output_t *new_output)
+    {
+        if (output)
+            output->get_data_safe<wobbly_output_batch_t>()->remove(this);
+
+        output = new_output;
+        if (output)
+            output->get_data_safe<wobbly_output_batch_t>()->add(output, this);
+    }
+
     void init_model()
     {
         model = std::make_unique<wobbly_surface> ();
@@ -521,11 +631,9 @@ class wf_wobbly : public wf::view_transformer_t
         model->grabbed = 0;
         model->synced = 1;
 
-        model->x_cells = wobbly_settings::resolution;
-        model->y_cells = wobbly_settings::resolution;
+        model->x_cells = std::max(1, (int)wobbly_settings::resolution);
+        model->y_cells = model->x_cells;
 
-        model->v = NULL;
-        model->uv = NULL;
         wobbly_init(model.get());
     }
 
@@ -536,8 +644,7 @@ class wf_wobbly : public wf::view_transformer_t
         init_model();
         last_frame = wf::get_current_time();
 
-        pre_hook = [=] () { update_model(); };
-        view->get_output()->render->add_effect(&pre_hook, wf::OUTPUT_EFFECT_PRE);
+        set_output(view->get_output());
 
         view->connect_signal("unmap", &view_removed);
         view->connect_signal("tiled", &view_state_changed);
@@ -577,7 +684,8 @@ class wf_wobbly : public wf::view_transformer_t
         return point;
     }
 
-    void update_model()
+    /** Let the wobbly state react to changes of the view geometry */
+    void update_state()
     {
         view->damage();
 
@@ -587,19 +695,33 @@ class wf_wobbly : public wf::view_transformer_t
             &this->view_geometry_changed);
         state->handle_frame();
         view->connect_signal("geometry-changed", &this->view_geometry_changed);
+    }
 
-        /* Update all the wobbly model */
-        auto now = wf::get_current_time();
+    /** Advance the wobbly model and update its geometry */
+    void update_model(uint32_t now)
+    {
         wobbly_prepare_paint(model.get(), now - last_frame);
 
-        /* Update wobbly geometry */
         last_frame = now;
         wobbly_add_geometry(model.get());
         wobbly_done_paint(model.get());
-        view->damage();
+    }
 
-        if (state->is_wobbly_done())
-            destroy_self();
+    /** Upload the mesh if it has changed. Requires bound opengl context */
+    void upload_mesh()
+    {
+        if (model->vertices_dirty)
+        {
+            wobbly_graphics::upload_vertices(vertex_buffer, model->vertices);
+            model->vertices_dirty = false;
+        }
+    }
+
+    /** @return true if the wobbly animation is done */
+    bool finish_frame()
+    {
+        view->damage();
+        return state->is_wobbly_done();
     }
 
     void render_box(wf::texture_t src_tex, wlr_box src_box,
@@ -608,12 +730,20 @@ class wf_wobbly : public wf::view_transformer_t
         OpenGL::render_begin(target_fb);
         target_fb.logic_scissor(scissor_box);
 
-        std::vector<float> vert, uv;
-        wobbly_graphics::prepare_geometry(model.get(), src_box, vert, uv);
-        wobbly_graphics::render_triangles(src_tex,
-            target_fb.get_orthographic_projection(),
-            vert.data(), uv.data(),
-            model->x_cells * model->y_cells * 2);
+        if (model->vertices.empty())
+        {
+            /* The model hasn't been deformed yet */
+            std::vector<float> vert;
+            wobbly_graphics::prepare_flat_geometry(model.get(), src_box, vert);
+            wobbly_graphics::upload_vertices(vertex_buffer, vert);
+        } else
+        {
+            upload_mesh();
+        }
+
+        wobbly_graphics::render_mesh(src_tex,
+            target_fb.get_orthographic_projection(), vertex_buffer,
+            model->x_cells, model->y_cells);
 
         OpenGL::render_end();
     }
@@ -730,8 +860,14 @@ class wf_wobbly : public wf::view_transformer_t
     virtual ~wf_wobbly()
     {
         state = nullptr;
-        wobbly_fini(model.get());
-        view->get_output()->render->rem_effect(&pre_hook);
+        set_output(nullptr);
+
+        if (vertex_buffer)
+        {
+            OpenGL::render_begin();
+            GL_CALL(glDeleteBuffers(1, &vertex_buffer));
+            OpenGL::render_end();
+        }
 
         view->disconnect_signal("unmap", &view_removed);
         view->disconnect_signal("tiled", &view_state_changed);
@@ -741,6 +877,24 @@ class wf_wobbly : public wf::view_transformer_t
     }
 };
 
+void wobbly_output_batch_t::update()
+{
+    views.for_each([] (wf_wobbly *view) { view->update_state(); });
+
+    auto now = wf::get_current_time();
+    views.for_each([=] (wf_wobbly *view) { view->update_model(now); });
+
+    OpenGL::render_begin();
+    views.for_each([] (wf_wobbly *view) { view->upload_mesh(); });
+    OpenGL::render_end();
+
+    views.for_each([] (wf_wobbly *view)
+    {
+        if (view->finish_frame())
+            view->destroy_self();
+    });
+}
+
 class wayfire_wobbly : public wf::plugin_interface_t
 {
     wf::signal_callback_t wobbly_changed;
@@ -800,6 +954,8 @@ class wayfire_wobbly : public wf::plugin_interface_t
                     wobbly->destroy_self();
             }
 
+            /* The batch's code lives in this plugin, so it must not outlive it */
+            output->erase_data<wobbly_output_batch_t>();
             wobbly_graphics::destroy_program();
             output->disconnect_signal("wobbly-event", &wobbly_changed);
         }
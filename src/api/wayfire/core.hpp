@@ -152,6 +152,19 @@ class compositor_core_t : public wf::object_base_t
      */
     virtual wf::surface_interface_t *get_touch_focus() = 0;
 
+    /**
+     * Find the topmost surface which accepts input at the given point, the
+     * same way pointer, touch and tablet input is delivered.
+     *
+     * @param point The point in global coordinates.
+     * @param local Set to the coordinates of the point relative to the
+     *   returned surface.
+     *
+     * @return The surface at the point, or null if there is no such surface.
+     */
+    virtual wf::surface_interface_t *get_surface_at(wf::pointf_t point,
+        wf::pointf_t& local) = 0;
+
     /** @return The view whose surface is cursor focus */
     wayfire_view get_cursor_focus_view();
     /** @return The view whose surface is touch focus */
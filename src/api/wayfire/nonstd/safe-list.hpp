@@ -1,122 +1,190 @@
 #ifndef WF_SAFE_LIST_HPP
 #define WF_SAFE_LIST_HPP
 
-#include <list>
+#include <vector>
 #include <memory>
+#include <optional>
 #include <algorithm>
-#include <functional>
-
-#include <wayland-server.h>
+#include <stdexcept>
+#include <cstdint>
 
 #include "reverse.hpp"
 
-/* This is a trimmed-down wrapper of std::list<T>.
+/* This is a list-like container whose slots are stored in a contiguous vector.
  *
  * It supports safe iteration over all elements in the collection, where any
- * element can be deleted from the list at any given time (i.e even in a
- * for-each-like loop) */
+ * element can be added to or deleted from the list at any given time (i.e
+ * even in a for-each-like loop).
+ *
+ * The elements are stored inline in slots, which are allocated in blocks of
+ * growing size and reused after their element is erased. Slots never move, so
+ * references to an element stay valid until it is erased, even when the
+ * vector of slots is reallocated, while adding an element does not need a
+ * separate allocation. Erased elements are left as tombstones while the list
+ * is being iterated, and their slots are reused only when the last iteration
+ * finishes. Elements added during an iteration are not visited by it, which
+ * is tracked by storing the generation in which each element was added. */
 namespace wf
 {
-    /* The object type depends on the safe list type, and the safe list type
-     * needs access to the event loop. However, the event loop is typically
-     * available from core.hpp. Because we can't resolve this circular dependency,
-     * we provide a link to the event loop specially for the safe list */
-    namespace _safe_list_detail
-    {
-        /* In main.cpp, and initialized there */
-        extern wl_event_loop* event_loop;
-        void idle_cleanup_func(void *data);
-    }
-
     template<class T>
     class safe_list_t
     {
-        std::list<std::unique_ptr<T>> list;
-        wl_event_source *idle_cleanup_source = NULL;
+        /* The storage of a single element */
+        using slot_t = std::optional<T>;
 
-        /* Remove all invalidated elements in the list */
-        std::function<void()> do_cleanup = [&] ()
+        struct element_t
         {
-            auto it = list.begin();
-            while (it != list.end())
+            slot_t *slot;
+            /* The value in slot, or null for erased elements */
+            T *value;
+            /* The generation in which the element was added */
+            uint64_t generation;
+        };
+
+        /* The size of the first block of slots, later blocks double in size */
+        static constexpr size_t FIRST_BLOCK_SIZE = 8;
+
+        /* A running iteration. Insertions update the positions of running
+         * iterations, so that they do not visit an element twice. */
+        struct iteration_t
+        {
+            size_t pos;
+            size_t end;
+            uint64_t generation;
+        };
+
+        /* Guard which registers an iteration for its lifetime */
+        class iteration_guard_t
+        {
+            const safe_list_t& list;
+
+          public:
+            iteration_t state;
+            iteration_guard_t(const safe_list_t& list, size_t pos)
+                : list(list), state{pos, list.elements.size(), list.generation}
             {
-                if (*it) {
-                    ++it;
-                } else {
-                    it = list.erase(it);
-                }
+                list.iterations.push_back(&state);
             }
 
-            idle_cleanup_source = NULL;
+            ~iteration_guard_t()
+            {
+                list.iterations.pop_back();
+                if (list.iterations.empty() && list.dirty)
+                    list.compact();
+            }
         };
 
-        /* Return whether the list has invalidated elements */
-        bool is_dirty() const
+        mutable std::vector<element_t> elements;
+        mutable std::vector<iteration_t*> iterations;
+        mutable bool dirty = false;
+        uint64_t generation = 0;
+        size_t alive = 0;
+
+        std::vector<std::unique_ptr<slot_t[]>> blocks;
+        size_t last_block_used = 0, last_block_size = 0;
+        /* Slots of erased elements, which are not in the list anymore */
+        mutable std::vector<slot_t*> free_slots;
+
+        /* Remove all erased elements from the list */
+        void compact() const
+        {
+            size_t kept = 0;
+            for (auto& el : elements)
+            {
+                if (el.value)
+                    elements[kept++] = el;
+                else
+                    free_slots.push_back(el.slot);
+            }
+
+            elements.resize(kept);
+            dirty = false;
+        }
+
+        slot_t *allocate_slot()
+        {
+            if (!free_slots.empty())
+            {
+                auto slot = free_slots.back();
+                free_slots.pop_back();
+                return slot;
+            }
+
+            if (blocks.empty() || last_block_used == last_block_size)
+            {
+                last_block_size = std::max(FIRST_BLOCK_SIZE, 2 * last_block_size);
+                blocks.push_back(std::make_unique<slot_t[]>(last_block_size));
+                last_block_used = 0;
+            }
+
+            return &blocks.back()[last_block_used++];
+        }
+
+        void insert_element(size_t pos, T&& value)
         {
-            return idle_cleanup_source;
+            auto slot = allocate_slot();
+            slot->emplace(std::move(value));
+            elements.insert(elements.begin() + pos,
+                element_t{slot, &slot->value(), ++generation});
+            ++alive;
+
+            for (auto& it : iterations)
+            {
+                if (pos <= it->pos)
+                    ++it->pos;
+                if (pos < it->end)
+                    ++it->end;
+            }
         }
 
         public:
         safe_list_t() {};
 
-        /* Copy the not-erased elements from other, but do not copy the idle source */
+        /* Copy the not-erased elements from other */
         safe_list_t(const safe_list_t& other) { *this = other; }
         safe_list_t& operator = (const safe_list_t& other)
         {
-            this->idle_cleanup_source = NULL;
+            if (this == &other)
+                return *this;
+
+            clear();
             other.for_each([&] (auto& el) {
                 this->push_back(el);
             });
+
+            return *this;
         }
 
         safe_list_t(safe_list_t&& other) = default;
         safe_list_t& operator = (safe_list_t&& other) = default;
 
-        ~safe_list_t()
-        {
-            if (idle_cleanup_source)
-                wl_event_source_remove(idle_cleanup_source);
-        }
-
         T& back()
         {
-            /* No invalidated elements */
-            if (!is_dirty())
-                return *list.back();
-
-            auto it = list.rbegin();
-            while (it != list.rend() && (*it) == nullptr)
+            auto it = elements.rbegin();
+            while (it != elements.rend() && !it->value)
                 ++it;
 
-            if (it == list.rend())
+            if (it == elements.rend())
                 throw std::out_of_range("back() called on an empty list!");
 
-            return **it;
+            return *it->value;
         }
 
         size_t size() const
         {
-            if (!is_dirty())
-                return list.size();
-
-            /* Count non-null elements, because that's the real size */
-            size_t sz = 0;
-            for (auto& it : list)
-                sz += (it != nullptr);
-
-            return sz;
+            return alive;
         }
 
         /* Push back by copying */
         void push_back(T value)
         {
-            list.push_back(std::make_unique<T> (std::move(value)));
+            insert_element(elements.size(), std::move(value));
         }
 
         /* Push back by moving */
         void emplace_back(T&& value)
         {
-            list.push_back(std::make_unique<T> (value));
+            insert_element(elements.size(), std::move(value));
         }
 
         enum insert_place_t
@@ -129,66 +197,66 @@ namespace wf
         /* Insert the given value at a position in the list, determined by the
          * check function. The value is inserted at the first position that
          * check indicates, or at the end of the list otherwise */
-        void emplace_at(T&& value, std::function<insert_place_t(T&)> check)
+        template<class Check>
+        void emplace_at(T&& value, Check check)
         {
-            auto it = list.begin();
-            while (it != list.end())
+            for (size_t i = 0; i < elements.size(); i++)
             {
                 /* Skip empty elements */
-                if (*it == nullptr)
-                {
-                    ++it;
+                if (!elements[i].value)
                     continue;
-                }
 
-                auto place = check(**it);
+                auto place = check(*elements[i].value);
                 switch (place)
                 {
                     case INSERT_AFTER:
-                        /* We can safely increment it, because it points to an
-                         * element in the list */
-                        ++it;
-                        // fall through
+                        insert_element(i + 1, std::move(value));
+                        return;
+
                     case INSERT_BEFORE:
-                        list.emplace(it, std::make_unique<T>(value));
+                        insert_element(i, std::move(value));
                         return;
 
                     default:
                         break;
                 }
-
-                ++it;
             }
 
             /* If no place found, insert at the end */
             emplace_back(std::move(value));
         }
 
-        void insert_at(T value, std::function<insert_place_t(T&)> check)
+        template<class Check>
+        void insert_at(T value, Check check)
         {
             emplace_at(std::move(value), check);
         }
 
         /* Call func for each non-erased element of the list */
-        void for_each(std::function<void(T&)> func) const
+        template<class Func>
+        void for_each(Func func) const
         {
-            /* Go through all elements currently in the list */
-            auto it = list.begin();
-            for (int size = list.size(); size > 0; size--, it++)
+            iteration_guard_t guard{*this, 0};
+            auto& it = guard.state;
+            for (; it.pos < it.end; it.pos++)
             {
-                if (*it)
-                    func(**it);
+                auto& el = elements[it.pos];
+                if (el.value && el.generation <= it.generation)
+                    func(*el.value);
             }
         }
 
         /* Call func for each non-erased element of the list in reversed order */
-        void for_each_reverse(std::function<void(T&)> func) const
+        template<class Func>
+        void for_each_reverse(Func func) const
         {
-            auto it = list.rbegin();
-            for (int size = list.size(); size > 0; size--, it++)
+            iteration_guard_t guard{*this, elements.size()};
+            auto& it = guard.state;
+            while (it.pos > 0)
             {
-                if (*it)
-                    func(**it);
+                auto& el = elements[--it.pos];
+                if (el.value && el.generation <= it.generation)
+                    func(*el.value);
             }
         }
 
@@ -205,27 +273,35 @@ namespace wf
         }
 
         /* Remove all elements satisfying a given condition.
-         * This function resets their pointers and scheduling a cleanup operation */
-        void remove_if(std::function<bool(const T&)> predicate)
+         * The elements are freed immediately, but stay as tombstones in the
+         * list until there are no running iterations */
+        template<class Pred>
+        void remove_if(Pred predicate)
         {
-            bool actually_removed = false;
-            for (auto& it : list)
+            /* Freeing an element may modify the list, so removal is treated
+             * as an iteration too */
+            iteration_guard_t guard{*this, 0};
+            auto& it = guard.state;
+            for (; it.pos < it.end; it.pos++)
             {
-                if (it && predicate(*it))
+                if (!elements[it.pos].value ||
+                    elements[it.pos].generation > it.generation ||
+                    !predicate(*elements[it.pos].value))
                 {
-                    actually_removed = true;
-                    /* First reset the element in the list, and then free resources */
-                    auto copy = std::move(it);
-                    it = nullptr;
-                    /* Now copy goes out of scope */
+                    continue;
                 }
-            }
 
-            /* Schedule a clean-up, but be careful to not schedule it twice */
-            if (!idle_cleanup_source && actually_removed)
-            {
-                idle_cleanup_source = wl_event_loop_add_idle(_safe_list_detail::event_loop,
-                    _safe_list_detail::idle_cleanup_func, &do_cleanup);
+                /* First reset the element in the list, and then free resources.
+                 * The predicate may have added elements, so the element is
+                 * looked up again rather than kept from before the call. The
+                 * slot isn't reused while this iteration is running. */
+                auto slot = elements[it.pos].slot;
+                elements[it.pos].value = nullptr;
+                auto copy = std::move(*slot);
+                slot->reset();
+                --alive;
+                dirty = true;
+                /* Now copy goes out of scope */
             }
         }
     };
@@ -21,6 +21,31 @@ struct signal_data_t
 using signal_callback_t = std::function<void(signal_data_t*)>;
 class signal_provider_t;
 
+/**
+ * An interned signal name.
+ *
+ * Connecting to and emitting signals by ID avoids hashing the signal name
+ * each time, so signals which are emitted many times per frame should be
+ * emitted by ID. Typically, the ID is created once and stored in a static
+ * variable.
+ */
+class signal_id_t
+{
+  public:
+    /** Get the ID of the given signal name. The same signal name always
+     * results in the same ID. */
+    explicit signal_id_t(const std::string& name);
+
+    /** @return A small integer identifying the signal. */
+    uint32_t get() const { return id; }
+
+    bool operator == (const signal_id_t& other) const { return id == other.id; }
+    bool operator != (const signal_id_t& other) const { return id != other.id; }
+
+  private:
+    uint32_t id;
+};
+
 /**
  * Provides an interface to connect to signal providers.
  *
@@ -60,6 +85,8 @@ class signal_provider_t
   public:
     /** Register a connection to be called when the given signal is emitted. */
     void connect_signal(std::string name, signal_connection_t* callback);
+    /** Register a connection to be called when the given signal is emitted. */
+    void connect_signal(signal_id_t id, signal_connection_t* callback);
     /** Unregister a connection. */
     void disconnect_signal(signal_connection_t *callback);
 
@@ -68,14 +95,18 @@ class signal_provider_t
      * Register a callback to be called whenever the given signal is emitted
      */
     void connect_signal(std::string name, signal_callback_t* callback);
+    void connect_signal(signal_id_t id, signal_callback_t* callback);
     /**
      * Deprecated.
      * Unregister a registered callback.
      */
     void disconnect_signal(std::string name, signal_callback_t* callback);
+    void disconnect_signal(signal_id_t id, signal_callback_t* callback);
 
     /** Emit the given signal. No type checking for data is required */
     void emit_signal(std::string name, signal_data_t *data);
+    /** Emit the given signal. No type checking for data is required */
+    void emit_signal(signal_id_t id, signal_data_t *data);
 
     virtual ~signal_provider_t();
 
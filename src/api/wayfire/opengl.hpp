@@ -8,6 +8,8 @@
 #include <wayfire/nonstd/noncopyable.hpp>
 
 #include <wayfire/geometry.hpp>
+#include <map>
+#include <string>
 
 #define GLM_FORCE_RADIANS
 #include <glm/mat4x4.hpp>
@@ -43,6 +45,10 @@ struct framebuffer_base_t : public noncopyable_t
     GLuint tex = -1, fb = -1;
     int32_t viewport_width = 0, viewport_height = 0;
 
+    /* The name under which the GPU memory of the buffer is accounted,
+     * for ex. the name of the plugin which uses it */
+    std::string owner;
+
     framebuffer_base_t() = default;
     framebuffer_base_t(framebuffer_base_t&& other);
     framebuffer_base_t& operator = (framebuffer_base_t&& other);
@@ -52,7 +58,10 @@ struct framebuffer_base_t : public noncopyable_t
 
     /* will invalidate texture contents if width or height changes.
      * If tex and/or fb haven't been set, it creates them
-     * Return true if texture was created/invalidated */
+     * Return true if texture was created/invalidated
+     *
+     * Buffers are taken from and returned to a pool shared by all
+     * framebuffers, so the tex and fb ids may change when resizing */
     bool allocate(int width, int height);
 
     /* Make the framebuffer current, and adjust viewport to its size */
@@ -62,7 +71,9 @@ struct framebuffer_base_t : public noncopyable_t
      * coordinate space */
     void scissor(wlr_box box) const;
 
-    /* Will destroy the texture and framebuffer
+    /* Will destroy the texture and framebuffer. If they were created by
+     * allocate(), they are instead returned to the pool of framebuffers for
+     * reuse.
      * Warning: will destroy tex/fb even if they have been allocated outside of
      * allocate() */
     void release();
@@ -72,6 +83,9 @@ struct framebuffer_base_t : public noncopyable_t
     void reset();
 
   private:
+    /* Whether tex and fb were created by allocate(), and can be pooled */
+    bool owns_buffer = false;
+
     void copy_state(framebuffer_base_t&& other);
 };
 
@@ -178,6 +192,75 @@ void render_end();
 /* Clear the currently bound framebuffer with the given color */
 void clear(wf::color_t color, uint32_t mask = GL_COLOR_BUFFER_BIT);
 
+/**
+ * Statistics about the pool of released framebuffers, which are reused by
+ * wf::framebuffer_base_t::allocate() for buffers of the same size.
+ */
+struct framebuffer_pool_stats_t
+{
+    /* Number of allocations which reused a buffer from the pool */
+    uint64_t hits = 0;
+    /* Number of allocations which created a new buffer */
+    uint64_t misses = 0;
+    /* Number of idle buffers in the pool */
+    uint32_t pooled_buffers = 0;
+    /* Memory used by the idle buffers in the pool, in bytes */
+    uint64_t pooled_bytes = 0;
+};
+
+/** Get the current statistics of the framebuffer pool */
+framebuffer_pool_stats_t get_framebuffer_pool_stats();
+
+/**
+ * Statistics about the programs created by compile_program(), which are
+ * loaded from a cache of program binaries when possible.
+ */
+struct program_cache_stats_t
+{
+    /* Number of programs which were compiled from source */
+    uint32_t compiled = 0;
+    /* Number of programs loaded from binaries cached on disk */
+    uint32_t loaded_from_disk = 0;
+    /* Number of programs loaded from binaries already used by this process */
+    uint32_t reused = 0;
+    /* Total time spent compiling programs, in microseconds */
+    int64_t compile_usec = 0;
+    /* Estimated time saved by loading cached binaries, in microseconds */
+    int64_t saved_usec = 0;
+};
+
+/** Get the current statistics of the program cache */
+program_cache_stats_t get_program_cache_stats();
+
+/**
+ * Account for the GPU memory used by a texture. Buffers allocated with
+ * wf::framebuffer_base_t are accounted automatically, this is needed only
+ * for textures which are allocated directly.
+ *
+ * Registering the same texture again updates its size and owner.
+ *
+ * @param tex The texture id.
+ * @param bytes The memory used by the texture.
+ * @param owner The name of the owner of the texture, for ex. a plugin name.
+ */
+void register_texture_memory(GLuint tex, uint64_t bytes,
+    const std::string& owner);
+
+/** Stop accounting for the given texture, for ex. when deleting it. */
+void unregister_texture_memory(GLuint tex);
+
+/** @return The accounted GPU memory in bytes, grouped by owner. */
+std::map<std::string, uint64_t> get_gpu_memory_usage();
+
+/** @return The total accounted GPU memory in bytes. */
+uint64_t get_total_gpu_memory_usage();
+
+/**
+ * @return Whether the accounted GPU memory exceeds the budget set by the
+ *   core/gpu_memory_budget option.
+ */
+bool is_gpu_memory_over_budget();
+
 
 enum texture_rendering_flags_t
 {
@@ -241,12 +324,47 @@ void render_texture(wf::texture_t texture,
     glm::vec4 color = glm::vec4(1.f),
     uint32_t bits = 0);
 
+/**
+ * Queue a textured quad for rendering on the given framebuffer, clipped to
+ * the given damage.
+ *
+ * In contrast to render_texture(), the quad is clipped on the CPU instead of
+ * with the scissor, and consecutive quads with the same texture and color are
+ * drawn together with a single draw call, from a vertex buffer which is reused
+ * across frames. Queued quads are drawn on flush_batch(), render_end(), and
+ * before any other rendering or scissor and framebuffer changes done with the
+ * functions here.
+ *
+ * @param texture   The texture to render.
+ * @param fb        The framebuffer to render onto.
+ *                  It should have been already bound.
+ * @param geometry  The geometry of the quad to render, in the same coordinate
+ *                    system as the framebuffer geometry.
+ * @param damage    The region to render, in the same coordinate system.
+ * @param color     A color multiplier for each channel of the texture.
+ */
+void render_texture_batched(wf::texture_t texture,
+    const wf::framebuffer_t& framebuffer,
+    const wf::geometry_t& geometry,
+    const wf::region_t& damage,
+    glm::vec4 color = glm::vec4(1.f));
+
+/**
+ * Draw the quads queued with render_texture_batched(). Needed only before
+ * making GL calls directly.
+ */
+void flush_batch();
+
 /* Compiles the given shader source */
 GLuint compile_shader(std::string source, GLuint type);
 
 /**
  * Create an OpenGL program from the given shader sources.
  *
+ * If the same sources have been compiled before, by this or an earlier
+ * instance of the compositor, the program is loaded from its cached binary
+ * instead, see core/program_cache.
+ *
  * @param vertex_source The source code of the vertex shader.
  * @param frag_source The source code of the fragment shader.
  */
@@ -261,6 +379,24 @@ GLuint compile_program(std::string vertex_source, std::string frag_source);
  */
 void render_rectangle(wf::geometry_t box, wf::color_t color, glm::mat4 matrix);
 
+/**
+ * A handle to a uniform of a program_t, see program_t::get_uniform().
+ * Handles stay valid when the program is compiled again.
+ */
+struct uniform_t
+{
+    int handle = -1;
+};
+
+/**
+ * A handle to an attribute of a program_t, see program_t::get_attrib().
+ * Handles stay valid when the program is compiled again.
+ */
+struct attrib_t
+{
+    int handle = -1;
+};
+
 /**
  * An OpenGL program for rendering texture_t.
  * It contains multiple programs for the different texture types.
@@ -312,6 +448,30 @@ class program_t : public noncopyable_t
     /** @return The program ID for the given texture type, or 0 on failure */
     int get_program_id(wf::texture_type_t type);
 
+    /**
+     * Resolve the given uniform in the programs for all texture types.
+     *
+     * Setting uniforms by handle avoids looking them up by name each time,
+     * so handles should be obtained once and kept. They may be obtained
+     * before the program is compiled.
+     * Uniforms which are not present in the program are ignored when set.
+     */
+    uniform_t get_uniform(const std::string& name);
+
+    /** Resolve the given attribute, analoguous to get_uniform(). */
+    attrib_t get_attrib(const std::string& name);
+
+    /*
+     * The functions below set the given uniform for the currently used
+     * program. The last value of each uniform is remembered, and setting the
+     * same value again does not result in a GL call.
+     */
+    void uniform1i(uniform_t uniform, int value);
+    void uniform1f(uniform_t uniform, float value);
+    void uniform2f(uniform_t uniform, float x, float y);
+    void uniform4f(uniform_t uniform, const glm::vec4& value);
+    void uniformMatrix4f(uniform_t uniform, const glm::mat4& value);
+
     /** Set the given uniform for the currently used program. */
     void uniform1i(const std::string& name, int value);
     /** Set the given uniform for the currently used program. */
@@ -332,6 +492,8 @@ class program_t : public noncopyable_t
      */
     void attrib_pointer(const std::string& attrib,
         int size, int stride, const void *ptr, GLenum type = GL_FLOAT);
+    void attrib_pointer(attrib_t attrib,
+        int size, int stride, const void *ptr, GLenum type = GL_FLOAT);
 
     /*
      * Set the attrib divisor. Analoguous to glVertexAttribDivisor().
@@ -340,6 +502,7 @@ class program_t : public noncopyable_t
      * @param divisor The divisor value.
      */
     void attrib_divisor(const std::string& attrib, int divisor);
+    void attrib_divisor(attrib_t attrib, int divisor);
 
     /**
      * Set the active texture, and modify the builtin Y-inversion uniforms.
@@ -3,6 +3,12 @@
 
 #include "wayfire/output.hpp"
 #include "wayfire/object.hpp"
+#include <vector>
+
+namespace OpenGL
+{
+class program_t;
+}
 
 namespace wf
 {
@@ -17,6 +23,22 @@ struct workspace_stream_t;
  * @param fb Indicates the framebuffer that the custom renderer should draw to */
 using render_hook_t = std::function<void(const wf::framebuffer_t& fb)>;
 
+/** Damage-aware render hooks are render hooks which repaint only the parts of
+ * the output which have changed since the last frame. Contrary to plain render
+ * hooks, the render manager swaps only the repainted region and does not
+ * disable the max_render_time delay for them.
+ *
+ * @param fb Indicates the framebuffer that the custom renderer should draw to
+ * @param damage The damage scheduled for this frame, in output-local
+ *   coordinates. It also contains the damage of the other workspaces, which
+ *   lies outside of the output.
+ *
+ * @return The region of the output which the hook repainted, in output-local
+ *   coordinates. It must include the part of the damage which lies on the
+ *   output. */
+using damage_render_hook_t = std::function<wf::region_t(
+    const wf::framebuffer_t& fb, const wf::region_t& damage)>;
+
 /* Effect hooks provide the plugins with a way to execute custom code
  * at certain parts of the repaint cycle */
 using effect_hook_t = std::function<void()>;
@@ -51,6 +73,124 @@ enum output_effect_type_t
 using post_hook_t = std::function<void(const wf::framebuffer_base_t& source,
     const wf::framebuffer_base_t& destination)>;
 
+/** Describes how damage on the source of a post hook affects its destination.
+ * The render manager uses it to find out which parts of the output have to
+ * pass through the post hooks each frame. */
+enum post_damage_type_t
+{
+    /* Each pixel of the destination depends only on the same pixel of the
+     * source, for ex. color filters */
+    POST_DAMAGE_IDENTITY = 0,
+    /* Each pixel of the destination depends on the source pixels in a square
+     * with the given padding around it, for ex. blurring */
+    POST_DAMAGE_PADDED   = 1,
+    /* The destination may change anywhere, even without damage on the source,
+     * for ex. zoom. Such hooks process the whole output each frame. */
+    POST_DAMAGE_FULL     = 2,
+};
+
+struct post_damage_t
+{
+    post_damage_type_t type = POST_DAMAGE_FULL;
+    /* The padding in pixels, for POST_DAMAGE_PADDED */
+    int padding = 0;
+};
+
+/** Post shaders are postprocessing effects which compute the color of each
+ * pixel only from its current color, for ex. color inversion or gamma
+ * adjustment. All post shaders on an output are linked into a single program,
+ * so that they cost a single pass over the output, regardless of their number.
+ */
+struct post_shader_t
+{
+    /* GLSL ES 1.00 source which defines the function named function_name,
+     * with the signature `vec4 function_name(vec4 color)`. The source may
+     * also define uniforms. All identifiers must be unique across post
+     * shaders, so they should be prefixed with the name of the plugin. */
+    std::string source;
+    std::string function_name;
+
+    /* Called with the linked program in use, so that the shader can set its
+     * uniforms. May be empty. */
+    std::function<void(OpenGL::program_t& program)> set_uniforms;
+};
+
+/**
+ * The phases of an output repaint, as measured by the render manager.
+ */
+enum frame_phase_t
+{
+    /* Querying the damage and making the output current */
+    FRAME_PHASE_DAMAGE      = 0,
+    /* The default renderer or the render hook */
+    FRAME_PHASE_RENDER      = 1,
+    /* Overlay effect hooks */
+    FRAME_PHASE_OVERLAY     = 2,
+    /* Rendering software cursors */
+    FRAME_PHASE_CURSORS     = 3,
+    /* Post hooks */
+    FRAME_PHASE_POSTPROCESS = 4,
+    /* Swapping the output buffers */
+    FRAME_PHASE_SWAP        = 5,
+    /* Post effect hooks and sending frame_done to clients */
+    FRAME_PHASE_FRAME_DONE  = 6,
+
+    /* Invalid phase, used internally */
+    FRAME_PHASE_TOTAL       = 7,
+};
+
+/**
+ * Timing information about a single repainted frame.
+ *
+ * Note that times are measured on the CPU. Since GL calls are asynchronous,
+ * GPU work usually shows up in the phase which waits for it, typically
+ * FRAME_PHASE_SWAP.
+ */
+struct frame_timings_t
+{
+    /* Time spent in each phase, in microseconds */
+    int64_t phase_usec[FRAME_PHASE_TOTAL] = {0};
+    /* Time spent for the whole frame, in microseconds */
+    int64_t frame_usec = 0;
+    /* Number of surfaces rendered in workspace streams */
+    uint32_t rendered_surfaces = 0;
+    /* The damaged area of the output, in output pixels */
+    int64_t damaged_area = 0;
+    /* Number of offscreen passes avoided by fusing view transformers */
+    uint32_t fused_transformer_passes = 0;
+};
+
+/**
+ * Compute a percentile of the given frame timings.
+ *
+ * @param frames The frames to compute the percentile over.
+ * @param percentile The percentile to compute, in the range [0, 100].
+ * @return The given percentile of each field of frame_timings_t, computed
+ *   independently over the frames. All fields are zero if there are no frames.
+ */
+frame_timings_t get_frame_timings_percentile(
+    const std::vector<frame_timings_t>& frames, double percentile);
+
+/**
+ * frame-timings is emitted on the render manager after every repainted frame.
+ */
+struct frame_timings_signal : public wf::signal_data_t
+{
+    const frame_timings_t& timings;
+    frame_timings_signal(const frame_timings_t& t) : timings(t) { }
+};
+
+/**
+ * Views which are fully covered by opaque views receive frame callbacks at a
+ * reduced rate, set by the core/occluded_frame_rate option. Plugins can store
+ * this custom data on a view to override the rate for that view.
+ */
+struct occluded_frame_rate_t : public wf::custom_data_t
+{
+    /* Frame callbacks per second, 0 for none and -1 to disable throttling */
+    int frame_rate = -1;
+};
+
 /** Render manager
  *
  * Each output has a render manager, which is responsible for all rendering
@@ -70,6 +210,14 @@ class render_manager : public wf::signal_provider_t
      */
     void set_renderer(render_hook_t rh = nullptr);
 
+    /**
+     * Set a damage-aware render hook to be used for rendering.
+     * Resetting the renderer is done with set_renderer(nullptr).
+     *
+     * @param rh The render hook to use, or nullptr for default renderer
+     */
+    void set_damage_renderer(damage_render_hook_t rh);
+
     /**
      * Rendering an output is done on demand, that is, when the output is
      * damaged. Some plugins however need to redraw the output as often as
@@ -111,8 +259,10 @@ class render_manager : public wf::signal_provider_t
      * Add a new post hook.
      *
      * @param hook The hook callack
+     * @param damage How the hook propagates damage. By default, the hook
+     *   processes the whole output each frame.
      */
-    void add_post(post_hook_t* hook);
+    void add_post(post_hook_t* hook, post_damage_t damage = {});
 
     /**
      * Remove a post hook. No-op if hook isn't active.
@@ -121,6 +271,21 @@ class render_manager : public wf::signal_provider_t
      */
     void rem_post(post_hook_t* hook);
 
+    /**
+     * Add a new post shader. Post shaders are applied in the order they were
+     * added, at the position of the first of them in the chain of post hooks.
+     *
+     * @param shader The shader to add. It must not be changed while added.
+     */
+    void add_post_shader(post_shader_t* shader);
+
+    /**
+     * Remove a post shader. No-op if the shader isn't active.
+     *
+     * @param shader The shader to be removed.
+     */
+    void rem_post_shader(post_shader_t* shader);
+
     /**
      * @return The damaged region on the current output for the current
      * frame that is used when swapping buffers. This function should
@@ -129,6 +294,33 @@ class render_manager : public wf::signal_provider_t
      */
     wf::region_t get_swap_damage();
 
+    /**
+     * @return The region of the destination buffer which the currently running
+     * post hook has to repaint, in framebuffer coordinates, i.e suitable for
+     * wf::framebuffer_base_t::scissor(). The hook may repaint more, but the
+     * rest of the destination is not swapped. This function should only be
+     * called from postprocessing effect callbacks. Otherwise it will return
+     * an empty region.
+     */
+    wf::region_t get_post_damage();
+
+    /**
+     * @return The number of views which were skipped during the current (or
+     * the last, if not in a repaint) frame because they were fully covered
+     * by opaque views. Meant for debugging.
+     */
+    uint32_t get_culled_views_count();
+
+    /**
+     * The render manager keeps the timings of the last repainted frames.
+     *
+     * @param percentile The percentile to compute, in the range [0, 100].
+     * @return The given percentile of each field of frame_timings_t, computed
+     *   independently over the recorded frames. All fields are zero if no
+     *   frames have been recorded yet.
+     */
+    frame_timings_t get_frame_timings_percentile(double percentile);
+
     /**
      * @return The damaged region on the current output for the current
      * frame. Note that a larger region might actually be repainted due to
@@ -181,17 +373,26 @@ class render_manager : public wf::signal_provider_t
      * attributes, you should stop the stream, and start it again
      *
      * @param stream The stream to be initialized
+     * @param scale_x The horizontal scale at which the stream is displayed
+     * @param scale_y The vertical scale at which the stream is displayed
+     *
+     * See workspace_stream_update() for the meaning of the scale.
      */
-    void workspace_stream_start(workspace_stream_t& stream);
+    void workspace_stream_start(workspace_stream_t& stream,
+        float scale_x = 1, float scale_y = 1);
 
     /**
      * Update the workspace stream with the latest contents on the workspace.
      * This function should be called inside the rendering cycle, i.e in a
      * render or an overlay hook.
      *
+     * If the stream is displayed scaled down, it can be rendered at a reduced
+     * resolution by passing the scale at which it is displayed. The stream is
+     * fully repainted whenever the rendering resolution changes.
+     *
      * @param stream The workspace stream to update
-     * @param scale_x Unused for now
-     * @param scale_y Unused for now
+     * @param scale_x The horizontal scale at which the stream is displayed
+     * @param scale_y The vertical scale at which the stream is displayed
      */
     void workspace_stream_update(workspace_stream_t& stream,
         float scale_x = 1, float scale_y = 1);
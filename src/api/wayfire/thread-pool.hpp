@@ -0,0 +1,51 @@
+#ifndef WF_THREAD_POOL_HPP
+#define WF_THREAD_POOL_HPP
+
+#include <functional>
+#include <memory>
+
+namespace wf
+{
+/**
+ * A pool of worker threads which is shared by the whole compositor.
+ *
+ * The workers are started on first use and live until the compositor exits,
+ * so plugins can offload work each frame without paying for thread creation.
+ * Tasks must not touch compositor state which isn't thread-safe, in
+ * particular they must not use GL or the Wayland APIs.
+ */
+class thread_pool_t
+{
+  public:
+    using task_t = std::function<void()>;
+    /** A function which processes the items in [start, end) */
+    using range_func_t = std::function<void(size_t start, size_t end)>;
+
+    thread_pool_t();
+    ~thread_pool_t();
+
+    /** Run the task asynchronously on one of the worker threads. */
+    void submit(task_t task);
+
+    /**
+     * Split the range [start, end) into chunks of at least min_chunk items
+     * and process them in parallel on the workers and the calling thread.
+     *
+     * Returns after all chunks have been processed.
+     */
+    void parallel_for(size_t start, size_t end, range_func_t func,
+        size_t min_chunk = 1);
+
+    /** @return The number of worker threads. */
+    size_t get_worker_count() const;
+
+  private:
+    class impl;
+    std::unique_ptr<impl> priv;
+};
+
+/** Get the compositor-wide thread pool */
+thread_pool_t& get_thread_pool();
+}
+
+#endif /* end of include guard: WF_THREAD_POOL_HPP */
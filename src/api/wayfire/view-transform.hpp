@@ -107,6 +107,28 @@ class view_transformer_t
     virtual void render_box(wf::texture_t src_tex, wlr_box src_box,
         wlr_box scissor_box, const wf::framebuffer_t& target_fb) {}
 
+    /**
+     * Describe the transformer as a matrix and a color multiplier, if that
+     * is all it does when rendering. Consecutive transformers which support
+     * this are rendered together in a single pass, without intermediate
+     * buffers.
+     *
+     * Subclasses which override render_with_damage() or render_box() of a
+     * transformer supporting this must override it too.
+     *
+     * @param src_box The bounding box of the view before this transformer,
+     *   in output-local coordinates.
+     * @param matrix Set to the matrix which maps points before the transform
+     *   to points after it, both in output-local coordinates. The result
+     *   may have w != 1, like for perspective projections.
+     * @param color Set to the color multiplier of the transformer.
+     *
+     * @return Whether the transformer can be fused with others. The default
+     *   implementation returns false.
+     */
+    virtual bool get_fused_transform(wf::geometry_t src_box,
+        glm::mat4& matrix, glm::vec4& color) { return false; }
+
     virtual ~view_transformer_t() {}
 };
 
@@ -132,6 +154,8 @@ class view_2D : public view_transformer_t
         wf::geometry_t view, wf::pointf_t point) override;
     void render_box(wf::texture_t src_tex, wlr_box src_box,
         wlr_box scissor_box, const wf::framebuffer_t& target_fb) override;
+    bool get_fused_transform(wf::geometry_t src_box,
+        glm::mat4& matrix, glm::vec4& color) override;
 };
 
 /* Those are centered relative to the view's bounding box */
@@ -156,12 +180,20 @@ class view_3D : public view_transformer_t
         wf::geometry_t view, wf::pointf_t point) override;
     void render_box(wf::texture_t src_tex, wlr_box src_box,
         wlr_box scissor_box, const wf::framebuffer_t& target_fb) override;
+    bool get_fused_transform(wf::geometry_t src_box,
+        glm::mat4& matrix, glm::vec4& color) override;
 
     static const float fov; // PI / 8
     static glm::mat4 default_view_matrix();
     static glm::mat4 default_proj_matrix();
 };
 
+/**
+ * @return The number of offscreen passes which have been avoided so far by
+ *   rendering consecutive transformers of a view in a single pass.
+ */
+uint64_t get_fused_transformer_passes();
+
 /* create a matrix which corresponds to the inverse of the given transform */
 glm::mat4 get_output_matrix_from_transform(wl_output_transform transform);
 
@@ -35,6 +35,22 @@ class compositor_core_impl_t : public compositor_core_t
 
     std::unique_ptr<input_manager> input;
 
+    /**
+     * A counter which is incremented every time something which may change
+     * the occlusion of views changes: the stacking order, the geometry of a
+     * view, the opaque region of a surface or its mapped state.
+     *
+     * Render managers compare it with the value their cached visibility map
+     * was computed with, see invalidate_visibility().
+     */
+    uint64_t visibility_serial = 0;
+
+    /** Mark the cached visibility information of all outputs as stale. */
+    void invalidate_visibility()
+    {
+        ++visibility_serial;
+    }
+
     /**
      * Initialize the compositor core. Called only by main()
      */
@@ -61,6 +77,8 @@ class compositor_core_impl_t : public compositor_core_t
 
     wf::surface_interface_t *get_cursor_focus() override;
     wf::surface_interface_t *get_touch_focus() override;
+    wf::surface_interface_t *get_surface_at(wf::pointf_t point,
+        wf::pointf_t& local) override;
 
     std::vector<nonstd::observer_ptr<wf::input_device_t>> get_input_devices() override;
     virtual wlr_cursor* get_wlr_cursor() override;
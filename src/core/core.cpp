@@ -332,6 +332,12 @@ wf::surface_interface_t *wf::compositor_core_impl_t::get_touch_focus()
     return input->touch_focus;
 }
 
+wf::surface_interface_t *wf::compositor_core_impl_t::get_surface_at(
+    wf::pointf_t point, wf::pointf_t& local)
+{
+    return input->input_surface_at(point, local);
+}
+
 wayfire_view wf::compositor_core_t::get_touch_focus_view()
 {
     auto focus = get_touch_focus();
@@ -1,6 +1,7 @@
 #include "wayfire/object.hpp"
-#include "wayfire/nonstd/safe-list.hpp"
 #include <unordered_map>
+#include <algorithm>
+#include <vector>
 #include <set>
 
 /* Implementation note: because of circular dependencies between
@@ -58,14 +59,121 @@ void wf::signal_connection_t::disconnect()
         provider->disconnect_signal(this);
 }
 
+/**
+ * Returns the table of interned signal names.
+ */
+static std::unordered_map<std::string, uint32_t>& get_signal_ids()
+{
+    static std::unordered_map<std::string, uint32_t> ids;
+    return ids;
+}
+
+wf::signal_id_t::signal_id_t(const std::string& name)
+{
+    auto& ids = get_signal_ids();
+    auto it = ids.find(name);
+    if (it == ids.end())
+        it = ids.emplace(name, ids.size()).first;
+
+    this->id = it->second;
+}
+
+/**
+ * A list of connections to a single signal.
+ *
+ * Connections are kept in a contiguous vector. Connections which are removed
+ * while the signal is being emitted are only reset, and the vector is
+ * compacted after the emission is over.
+ */
+template<class T>
+class connection_list_t
+{
+    std::vector<T*> connections;
+    int emitting = 0;
+    bool dirty = false;
+
+    void compact()
+    {
+        connections.erase(std::remove(connections.begin(), connections.end(),
+            nullptr), connections.end());
+        dirty = false;
+    }
+
+  public:
+    void add(T *connection)
+    {
+        connections.push_back(connection);
+    }
+
+    /** Remove all connections for which pred returns true */
+    template<class Pred> void remove_if(Pred pred)
+    {
+        for (auto& connection : connections)
+        {
+            if (connection && pred(connection))
+            {
+                connection = nullptr;
+                dirty = true;
+            }
+        }
+
+        if (dirty && !emitting)
+            compact();
+    }
+
+    /** Call func for each connection which existed before the call */
+    template<class Func> void for_each(Func func)
+    {
+        ++emitting;
+        /* Connections added by func are not called */
+        size_t count = connections.size();
+        for (size_t i = 0; i < count; i++)
+        {
+            if (connections[i])
+                func(connections[i]);
+        }
+
+        if (--emitting == 0 && dirty)
+            compact();
+    }
+};
+
 class wf::signal_provider_t::sprovider_impl
 {
   public:
-    std::unordered_map<std::string,
-        wf::safe_list_t<signal_connection_t*>> signals;
+    struct signal_t
+    {
+        connection_list_t<signal_connection_t> connections;
+        /* Deprecated */
+        connection_list_t<signal_callback_t> callbacks;
+    };
+
+    /* A provider usually has only a few signals connected, so a linear search
+     * in a contiguous vector of IDs is faster than hashing. The signals are
+     * stored in separate allocations, so that adding a new signal during
+     * emission does not invalidate the signal being emitted. */
+    std::vector<uint32_t> ids;
+    std::vector<std::unique_ptr<signal_t>> signals;
+
+    /** @return The signal with the given id, or NULL if it does not exist */
+    signal_t *find(signal_id_t id)
+    {
+        auto it = std::find(ids.begin(), ids.end(), id.get());
+        if (it == ids.end())
+            return nullptr;
+
+        return signals[it - ids.begin()].get();
+    }
 
-    std::unordered_map<std::string,
-        wf::safe_list_t<signal_callback_t*>> deprecated_signals;
+    signal_t& find_or_create(signal_id_t id)
+    {
+        if (auto signal = find(id))
+            return *signal;
+
+        ids.push_back(id.get());
+        signals.push_back(std::make_unique<signal_t>());
+        return *signals.back();
+    }
 };
 
 wf::signal_provider_t::signal_provider_t()
@@ -77,7 +185,7 @@ wf::signal_provider_t::~signal_provider_t()
 {
     for (auto& s : sprovider_priv->signals)
     {
-        s.second.for_each([=] (signal_connection_t *connection) {
+        s->connections.for_each([=] (signal_connection_t *connection) {
             connection->priv->remove(this);
         });
     }
@@ -86,7 +194,13 @@ wf::signal_provider_t::~signal_provider_t()
 void wf::signal_provider_t::connect_signal(std::string name,
     signal_connection_t* callback)
 {
-    sprovider_priv->signals[name].push_back(callback);
+    connect_signal(signal_id_t{name}, callback);
+}
+
+void wf::signal_provider_t::connect_signal(signal_id_t id,
+    signal_connection_t* callback)
+{
+    sprovider_priv->find_or_create(id).connections.add(callback);
     callback->priv->add(this);
 }
 
@@ -94,7 +208,7 @@ void wf::signal_provider_t::disconnect_signal(signal_connection_t* connection)
 {
     for (auto& s : sprovider_priv->signals)
     {
-        s.second.remove_if([=] (signal_connection_t *connected)
+        s->connections.remove_if([=] (signal_connection_t *connected)
         {
             if (connected == connection)
             {
@@ -110,25 +224,53 @@ void wf::signal_provider_t::disconnect_signal(signal_connection_t* connection)
 void wf::signal_provider_t::connect_signal(std::string name,
     signal_callback_t* callback)
 {
-    sprovider_priv->deprecated_signals[name].push_back(callback);
+    connect_signal(signal_id_t{name}, callback);
+}
+
+/* Deprecated: */
+void wf::signal_provider_t::connect_signal(signal_id_t id,
+    signal_callback_t* callback)
+{
+    sprovider_priv->find_or_create(id).callbacks.add(callback);
 }
 
 /* Deprecated: */
 void wf::signal_provider_t::disconnect_signal(std::string name,
     signal_callback_t* callback)
 {
-    sprovider_priv->deprecated_signals[name].remove_all(callback);
+    disconnect_signal(signal_id_t{name}, callback);
+}
+
+/* Deprecated: */
+void wf::signal_provider_t::disconnect_signal(signal_id_t id,
+    signal_callback_t* callback)
+{
+    if (auto signal = sprovider_priv->find(id))
+    {
+        signal->callbacks.remove_if([=] (signal_callback_t *connected) {
+            return connected == callback;
+        });
+    }
 }
 
 /* Emit the given signal. No type checking for data is required */
 void wf::signal_provider_t::emit_signal(std::string name, wf::signal_data_t *data)
 {
-    sprovider_priv->signals[name].for_each([data] (auto call) {
+    emit_signal(signal_id_t{name}, data);
+}
+
+void wf::signal_provider_t::emit_signal(signal_id_t id, wf::signal_data_t *data)
+{
+    auto signal = sprovider_priv->find(id);
+    if (!signal)
+        return;
+
+    signal->connections.for_each([data] (auto call) {
         call->emit(data);
     });
 
     /* Deprecated: */
-    sprovider_priv->deprecated_signals[name].for_each([data] (auto call) {
+    signal->callbacks.for_each([data] (auto call) {
         (*call)(data);
     });
 }
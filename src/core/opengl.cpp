@@ -1,7 +1,16 @@
 #include <wayfire/util/log.hpp>
+#include <wayfire/option-wrapper.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
 #include "opengl-priv.hpp"
+#include "program-cache.hpp"
 #include "wayfire/output.hpp"
+#include "wayfire/util.hpp"
 #include "core-impl.hpp"
 #include "config.h"
 
@@ -42,11 +51,239 @@ void gl_call(const char *func, uint32_t line, const char *glfunc) {
         gl_error_string(glGetError()));
 }
 
+namespace
+{
+/**
+ * Keeps track of the GPU memory used by textures, grouped by their owner.
+ */
+struct gpu_memory_tracker_t
+{
+    struct allocation_t
+    {
+        uint64_t bytes;
+        std::string owner;
+    };
+
+    std::unordered_map<GLuint, allocation_t> textures;
+    uint64_t total_bytes = 0;
+
+    void set(GLuint tex, uint64_t bytes, const std::string& owner)
+    {
+        remove(tex);
+        textures[tex] = {bytes, owner.empty() ? "unknown" : owner};
+        total_bytes += bytes;
+    }
+
+    void remove(GLuint tex)
+    {
+        auto it = textures.find(tex);
+        if (it != textures.end())
+        {
+            total_bytes -= it->second.bytes;
+            textures.erase(it);
+        }
+    }
+};
+
+gpu_memory_tracker_t& get_gpu_memory_tracker()
+{
+    static gpu_memory_tracker_t tracker;
+    return tracker;
+}
+
+uint64_t get_gpu_memory_budget()
+{
+    static wf::option_wrapper_t<int> budget{"core/gpu_memory_budget"};
+    return std::max(0, (int)budget) * 1024ull * 1024ull;
+}
+
+/**
+ * Buffers released by framebuffer_base_t are kept in a pool, bucketed by
+ * size, so that transient buffers, for ex. when animating or resizing views,
+ * can reuse them instead of allocating new GPU memory each time.
+ *
+ * Buffers which have been idle for a while, and the least recently released
+ * buffers above the size of the pool set by core/framebuffer_pool_size, are
+ * freed. Idle buffers are freed from a timer, so that they don't linger when
+ * no framebuffers are allocated or released anymore.
+ */
+struct framebuffer_pool_t
+{
+    static constexpr uint32_t max_idle_ms = 10000;
+    static constexpr const char *owner = "framebuffer-pool";
+
+    struct entry_t
+    {
+        GLuint fb, tex;
+        uint32_t released_at;
+    };
+
+    /* In each bucket, entries are ordered from least to most recently used */
+    std::map<std::pair<int, int>, std::vector<entry_t>> buckets;
+    OpenGL::framebuffer_pool_stats_t stats;
+
+    wf::option_wrapper_t<int> pool_size{"core/framebuffer_pool_size"};
+
+    wf::wl_timer idle_timer;
+    bool shutdown_received = false;
+    wf::signal_connection_t on_shutdown{[=] (void*) {
+        /* Disconnect timer, since otherwise it will be destroyed
+         * after the wayland display is. */
+        idle_timer.disconnect();
+        shutdown_received = true;
+    }};
+
+    framebuffer_pool_t()
+    {
+        wf::get_core().connect_signal("shutdown", &on_shutdown);
+    }
+
+    static uint64_t get_size_bytes(const std::pair<int, int>& size)
+    {
+        return 4ull * size.first * size.second;
+    }
+
+    /** Take a buffer with the given size from the pool, if available */
+    bool lease(int width, int height, GLuint& fb, GLuint& tex)
+    {
+        trim();
+
+        auto it = buckets.find({width, height});
+        if (it == buckets.end() || it->second.empty())
+        {
+            ++stats.misses;
+            return false;
+        }
+
+        fb = it->second.back().fb;
+        tex = it->second.back().tex;
+        it->second.pop_back();
+
+        --stats.pooled_buffers;
+        stats.pooled_bytes -= get_size_bytes(it->first);
+        ++stats.hits;
+        return true;
+    }
+
+    /** Return a buffer with the given size to the pool */
+    void put(GLuint fb, GLuint tex, int width, int height)
+    {
+        buckets[{width, height}].push_back({fb, tex, wf::get_current_time()});
+        get_gpu_memory_tracker().set(tex, get_size_bytes({width, height}), owner);
+        ++stats.pooled_buffers;
+        stats.pooled_bytes += get_size_bytes({width, height});
+        trim();
+        schedule_trim();
+    }
+
+    /**
+     * Arm the idle timer so that it fires when the least recently released
+     * buffer has been idle for max_idle_ms.
+     */
+    void schedule_trim()
+    {
+        if (shutdown_received)
+            return;
+
+        if (stats.pooled_buffers == 0)
+        {
+            idle_timer.disconnect();
+            return;
+        }
+
+        uint32_t oldest = wf::get_current_time();
+        for (auto& bucket : buckets)
+        {
+            if (!bucket.second.empty())
+                oldest = std::min(oldest, bucket.second.front().released_at);
+        }
+
+        uint32_t idle = wf::get_current_time() - oldest;
+        uint32_t timeout = idle < max_idle_ms ? max_idle_ms - idle : 1;
+        idle_timer.set_timeout(timeout, [=] () {
+            OpenGL::render_begin();
+            trim();
+            OpenGL::render_end();
+            schedule_trim();
+        });
+    }
+
+    /**
+     * Free the least recently used buffers until the pool uses at most
+     * max_bytes, and free all buffers which have been idle for too long.
+     */
+    void trim(uint64_t max_bytes)
+    {
+        uint32_t now = wf::get_current_time();
+        while (stats.pooled_buffers > 0)
+        {
+            auto oldest = buckets.end();
+            for (auto it = buckets.begin(); it != buckets.end(); ++it)
+            {
+                if (!it->second.empty() && (oldest == buckets.end() ||
+                    it->second.front().released_at <
+                    oldest->second.front().released_at))
+                {
+                    oldest = it;
+                }
+            }
+
+            auto& entry = oldest->second.front();
+            if (stats.pooled_bytes <= max_bytes &&
+                now - entry.released_at < max_idle_ms)
+            {
+                break;
+            }
+
+            GL_CALL(glDeleteFramebuffers(1, &entry.fb));
+            GL_CALL(glDeleteTextures(1, &entry.tex));
+            get_gpu_memory_tracker().remove(entry.tex);
+
+            --stats.pooled_buffers;
+            stats.pooled_bytes -= get_size_bytes(oldest->first);
+            oldest->second.erase(oldest->second.begin());
+            if (oldest->second.empty())
+                buckets.erase(oldest);
+        }
+    }
+
+    void trim()
+    {
+        uint64_t max_bytes = std::max(0, (int)pool_size) * 1024ull * 1024ull;
+
+        /* Free idle buffers first when over the GPU memory budget */
+        uint64_t budget = get_gpu_memory_budget();
+        uint64_t total = get_gpu_memory_tracker().total_bytes;
+        if (budget > 0 && total > budget)
+        {
+            uint64_t excess = std::min(total - budget, stats.pooled_bytes);
+            max_bytes = std::min(max_bytes, stats.pooled_bytes - excess);
+        }
+
+        trim(max_bytes);
+    }
+};
+
+framebuffer_pool_t& get_framebuffer_pool()
+{
+    static framebuffer_pool_t pool;
+    return pool;
+}
+}
+
 namespace OpenGL
 {
     /* Different Context is kept for each output */
     /* Each of the following functions uses the currently bound context */
     program_t program, color_program;
+
+    /* Handles of the uniforms and attributes of the default programs */
+    struct
+    {
+        attrib_t position, uv_position;
+        uniform_t mvp, color;
+    } program_handles, color_program_handles;
+
     GLuint compile_shader(std::string source, GLuint type)
     {
         GLuint shader = GL_CALL(glCreateShader(type));
@@ -74,17 +311,31 @@ namespace OpenGL
     /* Create a very simple gl program from the given shader sources */
     GLuint compile_program(std::string vertex_source, std::string frag_source)
     {
+        auto& cache = get_program_cache();
+        if (auto cached = cache.load(vertex_source, frag_source))
+            return cached;
+
+        timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
         auto vertex_shader = compile_shader(vertex_source, GL_VERTEX_SHADER);
         auto fragment_shader = compile_shader(frag_source, GL_FRAGMENT_SHADER);
         auto result_program = GL_CALL(glCreateProgram());
         GL_CALL(glAttachShader(result_program, vertex_shader));
         GL_CALL(glAttachShader(result_program, fragment_shader));
+        cache.prepare(result_program);
         GL_CALL(glLinkProgram(result_program));
 
         /* won't be really deleted until program is deleted as well */
         GL_CALL(glDeleteShader(vertex_shader));
         GL_CALL(glDeleteShader(fragment_shader));
 
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        int64_t compile_usec = (end.tv_sec - start.tv_sec) * 1000000ll +
+            (end.tv_nsec - start.tv_nsec) / 1000;
+        cache.count_compiled(compile_usec);
+        cache.store(result_program, vertex_source, frag_source, compile_usec);
+
         return result_program;
     }
 
@@ -98,6 +349,15 @@ namespace OpenGL
         color_program.set_simple(compile_program(default_vertex_shader_source,
                 color_rect_fragment_source));
 
+        program_handles.position = program.get_attrib("position");
+        program_handles.uv_position = program.get_attrib("uvPosition");
+        program_handles.mvp = program.get_uniform("MVP");
+        program_handles.color = program.get_uniform("color");
+
+        color_program_handles.position = color_program.get_attrib("position");
+        color_program_handles.mvp = color_program.get_uniform("MVP");
+        color_program_handles.color = color_program.get_uniform("color");
+
         render_end();
     }
 
@@ -106,6 +366,8 @@ namespace OpenGL
         render_begin();
         program.free_resources();
         color_program.free_resources();
+        quad_batch.free_resources();
+        get_framebuffer_pool().trim(0);
         render_end();
     }
 
@@ -124,10 +386,167 @@ namespace OpenGL
         current_output = NULL;
     }
 
+    /**
+     * Collects textured quads which share the same texture and uniforms, and
+     * draws them with a single call, from a vertex buffer which is reused
+     * across frames.
+     */
+    struct quad_batch_t
+    {
+        /* x, y, u, v of each vertex, two triangles per quad */
+        std::vector<GLfloat> vertices;
+        GLuint vbo = 0;
+        size_t vbo_size = 0;
+
+        /* The state shared by all queued quads */
+        wf::texture_t texture;
+        glm::mat4 transform;
+        glm::vec4 color;
+
+        bool can_batch(const wf::texture_t& texture, const glm::mat4& transform,
+            const glm::vec4& color) const
+        {
+            return texture.tex_id == this->texture.tex_id &&
+                texture.target == this->texture.target &&
+                texture.type == this->texture.type &&
+                texture.invert_y == this->texture.invert_y &&
+                transform == this->transform && color == this->color;
+        }
+
+        void add_quad(const gl_geometry& pos, const gl_geometry& uv)
+        {
+            vertices.insert(vertices.end(), {
+                pos.x1, pos.y1, uv.x1, uv.y1,
+                pos.x2, pos.y1, uv.x2, uv.y1,
+                pos.x2, pos.y2, uv.x2, uv.y2,
+                pos.x1, pos.y1, uv.x1, uv.y1,
+                pos.x2, pos.y2, uv.x2, uv.y2,
+                pos.x1, pos.y2, uv.x1, uv.y2,
+            });
+        }
+
+        void flush()
+        {
+            if (vertices.empty())
+                return;
+
+            program.use(texture.type);
+            program.set_active_texture(texture);
+
+            size_t size = vertices.size() * sizeof(GLfloat);
+            if (!vbo)
+                GL_CALL(glGenBuffers(1, &vbo));
+
+            /* Orphan the previous storage, so that the driver doesn't have to
+             * wait for the draws which still use it */
+            vbo_size = std::max(vbo_size, size);
+            GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, vbo));
+            GL_CALL(glBufferData(GL_ARRAY_BUFFER, vbo_size, NULL, GL_STREAM_DRAW));
+            GL_CALL(glBufferSubData(GL_ARRAY_BUFFER, 0, size, vertices.data()));
+
+            const GLsizei stride = 4 * sizeof(GLfloat);
+            program.attrib_pointer(program_handles.position,
+                2, stride, (void*)0);
+            program.attrib_pointer(program_handles.uv_position, 2, stride,
+                (void*)(2 * sizeof(GLfloat)));
+            program.uniformMatrix4f(program_handles.mvp, transform);
+            program.uniform4f(program_handles.color, color);
+
+            /* The quads are already clipped, but the scissor state of the
+             * caller has to be kept */
+            GLboolean had_scissor = GL_CALL(glIsEnabled(GL_SCISSOR_TEST));
+            GL_CALL(glDisable(GL_SCISSOR_TEST));
+            GL_CALL(glEnable(GL_BLEND));
+            GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
+            GL_CALL(glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 4));
+            if (had_scissor)
+            {
+                GL_CALL(glEnable(GL_SCISSOR_TEST));
+            }
+
+            program.deactivate();
+            GL_CALL(glBindBuffer(GL_ARRAY_BUFFER, 0));
+            vertices.clear();
+        }
+
+        void free_resources()
+        {
+            vertices.clear();
+            if (vbo)
+                GL_CALL(glDeleteBuffers(1, &vbo));
+
+            vbo = 0;
+            vbo_size = 0;
+        }
+    };
+
+    quad_batch_t quad_batch;
+
+    void flush_batch()
+    {
+        quad_batch.flush();
+    }
+
+    void render_texture_batched(wf::texture_t texture,
+        const wf::framebuffer_t& framebuffer, const wf::geometry_t& geometry,
+        const wf::region_t& damage, glm::vec4 color)
+    {
+        if (geometry.width <= 0 || geometry.height <= 0)
+            return;
+
+        auto transform = framebuffer.get_orthographic_projection();
+        if (quad_batch.vertices.empty() ||
+            !quad_batch.can_batch(texture, transform, color))
+        {
+            quad_batch.flush();
+            quad_batch.texture = texture;
+            quad_batch.transform = transform;
+            quad_batch.color = color;
+        }
+
+        /* Same texture coordinates as render_transformed_texture() */
+        auto get_u = [&] (float x) {
+            return (x - geometry.x) / geometry.width;
+        };
+        auto get_v = [&] (float y) {
+            return (geometry.y + geometry.height - y) / geometry.height;
+        };
+
+        /* Expand the damage to whole framebuffer pixels, like the scissor
+         * box from framebuffer_t::logic_scissor(), otherwise pixels which
+         * are only partially damaged are not redrawn with fractional scale */
+        const auto& fb_geometry = framebuffer.geometry;
+        const float scale = framebuffer.scale;
+        auto snap = [&] (float coord, float origin, bool round_up) {
+            float pixels = (coord - origin) * scale;
+            pixels = round_up ? std::ceil(pixels) : std::floor(pixels);
+            return pixels / scale + origin;
+        };
+
+        for (const auto& rect : damage)
+        {
+            gl_geometry pos = {
+                std::max<float>(snap(rect.x1, fb_geometry.x, false), geometry.x),
+                std::max<float>(snap(rect.y1, fb_geometry.y, false), geometry.y),
+                std::min<float>(snap(rect.x2, fb_geometry.x, true),
+                    geometry.x + geometry.width),
+                std::min<float>(snap(rect.y2, fb_geometry.y, true),
+                    geometry.y + geometry.height),
+            };
+
+            if (pos.x1 >= pos.x2 || pos.y1 >= pos.y2)
+                continue;
+
+            quad_batch.add_quad(pos, {get_u(pos.x1), get_v(pos.y1),
+                get_u(pos.x2), get_v(pos.y2)});
+        }
+    }
+
     void render_transformed_texture(wf::texture_t tex,
         const gl_geometry& g, const gl_geometry& texg,
         glm::mat4 model, glm::vec4 color, uint32_t bits)
     {
+        flush_batch();
         program.use(tex.type);
 
         gl_geometry final_g = g;
@@ -158,10 +577,10 @@ namespace OpenGL
         }
 
         program.set_active_texture(tex);
-        program.attrib_pointer("position", 2, 0, vertexData);
-        program.attrib_pointer("uvPosition", 2, 0, coordData);
-        program.uniformMatrix4f("MVP", model);
-        program.uniform4f("color", color);
+        program.attrib_pointer(program_handles.position, 2, 0, vertexData);
+        program.attrib_pointer(program_handles.uv_position, 2, 0, coordData);
+        program.uniformMatrix4f(program_handles.mvp, model);
+        program.uniform4f(program_handles.color, color);
 
         GL_CALL(glEnable(GL_BLEND));
         GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
@@ -195,6 +614,7 @@ namespace OpenGL
     void render_rectangle(wf::geometry_t geometry, wf::color_t color,
         glm::mat4 matrix)
     {
+        flush_batch();
         color_program.use(wf::TEXTURE_TYPE_RGBA);
         float x = geometry.x, y = geometry.y,
               w = geometry.width, h = geometry.height;
@@ -206,9 +626,11 @@ namespace OpenGL
             x, y,
         };
 
-        color_program.attrib_pointer("position", 2, 0, vertexData);
-        color_program.uniformMatrix4f("MVP", matrix);
-        color_program.uniform4f("color", {color.r, color.g, color.b, color.a});
+        color_program.attrib_pointer(color_program_handles.position,
+            2, 0, vertexData);
+        color_program.uniformMatrix4f(color_program_handles.mvp, matrix);
+        color_program.uniform4f(color_program_handles.color,
+            {color.r, color.g, color.b, color.a});
 
         GL_CALL(glEnable(GL_BLEND));
         GL_CALL(glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA));
@@ -233,6 +655,7 @@ namespace OpenGL
         if (!current_output && !wlr_egl_is_current(wf::get_core_impl().egl))
             wlr_egl_make_current(wf::get_core_impl().egl, EGL_NO_SURFACE, NULL);
 
+        flush_batch();
         wlr_renderer_begin(wf::get_core_impl().renderer,
             viewport_width, viewport_height);
         GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, fb));
@@ -240,20 +663,92 @@ namespace OpenGL
 
     void clear(wf::color_t col, uint32_t mask)
     {
+        flush_batch();
         GL_CALL(glClearColor(col.r, col.g, col.b, col.a));
         GL_CALL(glClear(mask));
     }
 
     void render_end()
     {
+        flush_batch();
         GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
         wlr_renderer_scissor(wf::get_core().renderer, NULL);
         wlr_renderer_end(wf::get_core().renderer);
     }
 }
 
+OpenGL::framebuffer_pool_stats_t OpenGL::get_framebuffer_pool_stats()
+{
+    return get_framebuffer_pool().stats;
+}
+
+OpenGL::program_cache_stats_t OpenGL::get_program_cache_stats()
+{
+    return get_program_cache().get_stats();
+}
+
+void OpenGL::register_texture_memory(GLuint tex, uint64_t bytes,
+    const std::string& owner)
+{
+    get_gpu_memory_tracker().set(tex, bytes, owner);
+}
+
+void OpenGL::unregister_texture_memory(GLuint tex)
+{
+    get_gpu_memory_tracker().remove(tex);
+}
+
+std::map<std::string, uint64_t> OpenGL::get_gpu_memory_usage()
+{
+    std::map<std::string, uint64_t> usage;
+    for (auto& tex : get_gpu_memory_tracker().textures)
+        usage[tex.second.owner] += tex.second.bytes;
+
+    return usage;
+}
+
+uint64_t OpenGL::get_total_gpu_memory_usage()
+{
+    return get_gpu_memory_tracker().total_bytes;
+}
+
+bool OpenGL::is_gpu_memory_over_budget()
+{
+    uint64_t budget = get_gpu_memory_budget();
+    return budget > 0 && get_total_gpu_memory_usage() > budget;
+}
+
 bool wf::framebuffer_base_t::allocate(int width, int height)
 {
+    /* Instead of resizing the texture in place, exchange the buffer for one
+     * with the right size from the pool. Buffers which were not created by
+     * allocate() are resized in place. */
+    if (owns_buffer && (width != viewport_width || height != viewport_height))
+        release();
+
+    /* Only a framebuffer without any buffer takes one from the pool. One
+     * which already has a buffer of the right size keeps it, together with
+     * its contents. */
+    bool has_buffer = fb != (uint32_t)-1 || tex != (uint32_t)-1;
+    if (!has_buffer)
+        owns_buffer = true;
+
+    if (!has_buffer && get_framebuffer_pool().lease(width, height, fb, tex))
+    {
+        /* The previous user might have changed the texture parameters */
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, tex));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+        GL_CALL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
+        GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
+
+        viewport_width = width;
+        viewport_height = height;
+        get_gpu_memory_tracker().set(tex, 4ull * width * height, owner);
+        return true;
+    }
+
     bool first_allocate = false;
     if (fb == (uint32_t)-1)
     {
@@ -306,6 +801,8 @@ bool wf::framebuffer_base_t::allocate(int width, int height)
 
     viewport_width = width;
     viewport_height = height;
+    if (fb != 0 && (is_resize || first_allocate))
+        get_gpu_memory_tracker().set(tex, 4ull * width * height, owner);
 
     GL_CALL(glBindTexture(GL_TEXTURE_2D, 0));
     GL_CALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
@@ -320,6 +817,8 @@ void wf::framebuffer_base_t::copy_state(wf::framebuffer_base_t&& other)
 
     this->fb = other.fb;
     this->tex = other.tex;
+    this->owner = other.owner;
+    this->owns_buffer = other.owns_buffer;
 
     other.reset();
 }
@@ -342,12 +841,14 @@ wf::framebuffer_base_t& wf::framebuffer_base_t::operator = (wf::framebuffer_base
 
 void wf::framebuffer_base_t::bind() const
 {
+    OpenGL::flush_batch();
     GL_CALL(glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fb));
     GL_CALL(glViewport(0, 0, viewport_width, viewport_height));
 }
 
 void wf::framebuffer_base_t::scissor(wlr_box box) const
 {
+    OpenGL::flush_batch();
     GL_CALL(glEnable(GL_SCISSOR_TEST));
     GL_CALL(glScissor(box.x, viewport_height - box.y - box.height,
                       box.width, box.height));
@@ -355,6 +856,14 @@ void wf::framebuffer_base_t::scissor(wlr_box box) const
 
 void wf::framebuffer_base_t::release()
 {
+    /* Buffers created by allocate() can be reused by other framebuffers */
+    if (owns_buffer && viewport_width > 0 && viewport_height > 0)
+    {
+        get_framebuffer_pool().put(fb, tex, viewport_width, viewport_height);
+        reset();
+        return;
+    }
+
     if (fb != uint32_t(-1) && fb != 0)
     {
         GL_CALL(glDeleteFramebuffers(1, &fb));
@@ -363,6 +872,7 @@ void wf::framebuffer_base_t::release()
     if (tex != uint32_t(-1) && (fb != 0 || tex != 0))
     {
         GL_CALL(glDeleteTextures(1, &tex));
+        get_gpu_memory_tracker().remove(tex);
     }
 
     reset();
@@ -373,6 +883,7 @@ void wf::framebuffer_base_t::reset()
     fb = -1;
     tex = -1;
     viewport_width = viewport_height = 0;
+    owns_buffer = false;
 }
 
 wlr_box wf::framebuffer_t::framebuffer_box_from_geometry_box(wlr_box box) const
@@ -481,32 +992,124 @@ class program_t::impl
 
     int active_program_idx = 0;
 
-    int id[wf::TEXTURE_TYPE_ALL];
-    std::map<std::string, int> uniforms[wf::TEXTURE_TYPE_ALL];
+    int id[wf::TEXTURE_TYPE_ALL] = {0};
+
+    /* The location of a uniform and the value it was last set to */
+    struct uniform_state_t
+    {
+        int location = -1;
+        bool has_value = false;
+        std::array<float, 16> value;
+    };
+
+    /* Registered names, indexed by handle */
+    std::vector<std::string> uniform_names, attrib_names;
+    std::unordered_map<std::string, int> uniform_handles, attrib_handles;
+
+    /* For each texture type, indexed by handle */
+    std::vector<uniform_state_t> uniforms[wf::TEXTURE_TYPE_ALL];
+    std::vector<int> attribs[wf::TEXTURE_TYPE_ALL];
+
+    /* Handles of the builtin uniforms */
+    uniform_t y_base = get_uniform("_wayfire_y_base");
+    uniform_t y_mult = get_uniform("_wayfire_y_mult");
+
+    int find_uniform_loc(int type, const std::string& name)
+    {
+        if (!id[type])
+            return -1;
+
+        return GL_CALL(glGetUniformLocation(id[type], name.c_str()));
+    }
+
+    int find_attrib_loc(int type, const std::string& name)
+    {
+        if (!id[type])
+            return -1;
+
+        return GL_CALL(glGetAttribLocation(id[type], name.c_str()));
+    }
+
+    uniform_t get_uniform(const std::string& name)
+    {
+        auto it = uniform_handles.find(name);
+        if (it != uniform_handles.end())
+            return {it->second};
+
+        int handle = uniform_names.size();
+        uniform_names.push_back(name);
+        uniform_handles[name] = handle;
+        for (int i = 0; i < wf::TEXTURE_TYPE_ALL; i++)
+        {
+            uniforms[i].emplace_back();
+            uniforms[i].back().location = find_uniform_loc(i, name);
+        }
+
+        return {handle};
+    }
 
-    /** Find the uniform location for the currently bound program */
-    int find_uniform_loc(const std::string& name)
+    attrib_t get_attrib(const std::string& name)
     {
-        auto it = uniforms[active_program_idx].find(name);
-        if (it != uniforms[active_program_idx].end())
-            return it->second;
+        auto it = attrib_handles.find(name);
+        if (it != attrib_handles.end())
+            return {it->second};
+
+        int handle = attrib_names.size();
+        attrib_names.push_back(name);
+        attrib_handles[name] = handle;
+        for (int i = 0; i < wf::TEXTURE_TYPE_ALL; i++)
+            attribs[i].push_back(find_attrib_loc(i, name));
 
-        uniforms[active_program_idx][name] =
-            GL_CALL(glGetUniformLocation(id[active_program_idx], name.c_str()));
-        return uniforms[active_program_idx][name];
+        return {handle};
     }
 
-    std::map<std::string, int> attribs[wf::TEXTURE_TYPE_ALL];
-    /** Find the attrib location for the currently bound program */
-    int find_attrib_loc(const std::string& name)
+    /** Look up all handles again, after the programs have changed */
+    void resolve_handles()
     {
-        auto it = attribs[active_program_idx].find(name);
-        if (it != attribs[active_program_idx].end())
-            return it->second;
+        for (int i = 0; i < wf::TEXTURE_TYPE_ALL; i++)
+        {
+            uniforms[i].assign(uniform_names.size(), {});
+            for (size_t j = 0; j < uniform_names.size(); j++)
+                uniforms[i][j].location = find_uniform_loc(i, uniform_names[j]);
 
-        attribs[active_program_idx][name] =
-            GL_CALL(glGetAttribLocation(id[active_program_idx], name.c_str()));
-        return attribs[active_program_idx][name];
+            attribs[i].resize(attrib_names.size());
+            for (size_t j = 0; j < attrib_names.size(); j++)
+                attribs[i][j] = find_attrib_loc(i, attrib_names[j]);
+        }
+    }
+
+    /**
+     * Remember the new value of a uniform of the active program.
+     *
+     * @return The location of the uniform, or -1 if it does not exist or
+     *   already has the given value.
+     */
+    int update_uniform(uniform_t uniform, const float *value, int count)
+    {
+        if (uniform.handle < 0)
+            return -1;
+
+        auto& state = uniforms[active_program_idx].at(uniform.handle);
+        if (state.location < 0)
+            return -1;
+
+        if (state.has_value &&
+            std::equal(value, value + count, state.value.begin()))
+        {
+            return -1;
+        }
+
+        std::copy(value, value + count, state.value.begin());
+        state.has_value = true;
+        return state.location;
+    }
+
+    int get_attrib_loc(attrib_t attrib)
+    {
+        if (attrib.handle < 0)
+            return -1;
+
+        return attribs[active_program_idx].at(attrib.handle);
     }
 };
 
@@ -522,6 +1125,7 @@ void program_t::set_simple(GLuint program_id, wf::texture_type_t type)
     free_resources();
     assert(type < wf::TEXTURE_TYPE_ALL);
     this->priv->id[type] = program_id;
+    this->priv->resolve_handles();
 }
 
 program_t::~program_t() {}
@@ -565,6 +1169,8 @@ void program_t::compile(const std::string& vertex_source,
         this->priv->id[program_type.first] =
             compile_program(vertex_source, fragment);
     }
+
+    this->priv->resolve_handles();
 }
 
 void program_t::free_resources()
@@ -577,6 +1183,9 @@ void program_t::free_resources()
             this->priv->id[i] = 0;
         }
     }
+
+    /* The locations may differ if the program is compiled again */
+    this->priv->resolve_handles();
 }
 
 void program_t::use(wf::texture_type_t type)
@@ -596,62 +1205,120 @@ int program_t::get_program_id(wf::texture_type_t type)
     return priv->id[type];
 }
 
+uniform_t program_t::get_uniform(const std::string& name)
+{
+    return priv->get_uniform(name);
+}
+
+attrib_t program_t::get_attrib(const std::string& name)
+{
+    return priv->get_attrib(name);
+}
+
+void program_t::uniform1i(uniform_t uniform, int value)
+{
+    float cached = value;
+    int loc = priv->update_uniform(uniform, &cached, 1);
+    if (loc >= 0)
+        GL_CALL(glUniform1i(loc, value));
+}
+
+void program_t::uniform1f(uniform_t uniform, float value)
+{
+    int loc = priv->update_uniform(uniform, &value, 1);
+    if (loc >= 0)
+        GL_CALL(glUniform1f(loc, value));
+}
+
+void program_t::uniform2f(uniform_t uniform, float x, float y)
+{
+    float value[] = {x, y};
+    int loc = priv->update_uniform(uniform, value, 2);
+    if (loc >= 0)
+        GL_CALL(glUniform2f(loc, x, y));
+}
+
+void program_t::uniform4f(uniform_t uniform, const glm::vec4& value)
+{
+    float cached[] = {value.r, value.g, value.b, value.a};
+    int loc = priv->update_uniform(uniform, cached, 4);
+    if (loc >= 0)
+        GL_CALL(glUniform4f(loc, value.r, value.g, value.b, value.a));
+}
+
+void program_t::uniformMatrix4f(uniform_t uniform, const glm::mat4& value)
+{
+    int loc = priv->update_uniform(uniform, &value[0][0], 16);
+    if (loc >= 0)
+        GL_CALL(glUniformMatrix4fv(loc, 1, GL_FALSE, &value[0][0]));
+}
+
 void program_t::uniform1i(const std::string& name, int value)
 {
-    int loc = priv->find_uniform_loc(name);
-    GL_CALL(glUniform1i(loc, value));
+    uniform1i(get_uniform(name), value);
 }
 
 void program_t::uniform1f(const std::string& name, float value)
 {
-    int loc = priv->find_uniform_loc(name);
-    GL_CALL(glUniform1f(loc, value));
-
+    uniform1f(get_uniform(name), value);
 }
 
 void program_t::uniform2f(const std::string& name, float x, float y)
 {
-    int loc = priv->find_uniform_loc(name);
-    GL_CALL(glUniform2f(loc, x, y));
+    uniform2f(get_uniform(name), x, y);
 }
 
 void program_t::uniform4f(const std::string& name, const glm::vec4& value)
 {
-    int loc = priv->find_uniform_loc(name);
-    GL_CALL(glUniform4f(loc, value.r, value.g, value.b, value.a));
+    uniform4f(get_uniform(name), value);
 }
 
 void program_t::uniformMatrix4f(const std::string& name, const glm::mat4& value)
 {
-    int loc = priv->find_uniform_loc(name);
-    GL_CALL(glUniformMatrix4fv(loc, 1, GL_FALSE, &value[0][0]));
+    uniformMatrix4f(get_uniform(name), value);
 }
 
-void program_t::attrib_pointer(const std::string& attrib,
+void program_t::attrib_pointer(attrib_t attrib,
     int size, int stride, const void *ptr, GLenum type)
 {
-    int loc = priv->find_attrib_loc(attrib);
-    priv->active_attrs.insert(loc);
+    int loc = priv->get_attrib_loc(attrib);
+    if (loc < 0)
+        return;
 
+    priv->active_attrs.insert(loc);
     GL_CALL(glEnableVertexAttribArray(loc));
     GL_CALL(glVertexAttribPointer(loc, size, type, GL_FALSE, stride, ptr));
 }
 
-void program_t::attrib_divisor(const std::string& attrib, int divisor)
+void program_t::attrib_divisor(attrib_t attrib, int divisor)
 {
-    int loc = priv->find_attrib_loc(attrib);
+    int loc = priv->get_attrib_loc(attrib);
+    if (loc < 0)
+        return;
+
     priv->active_attrs_divisors.insert(loc);
     GL_CALL(glVertexAttribDivisor(loc, divisor));
 }
 
+void program_t::attrib_pointer(const std::string& attrib,
+    int size, int stride, const void *ptr, GLenum type)
+{
+    attrib_pointer(get_attrib(attrib), size, stride, ptr, type);
+}
+
+void program_t::attrib_divisor(const std::string& attrib, int divisor)
+{
+    attrib_divisor(get_attrib(attrib), divisor);
+}
+
 void program_t::set_active_texture(const wf::texture_t& texture)
 {
     GL_CALL(glActiveTexture(GL_TEXTURE0));
     GL_CALL(glBindTexture(texture.target, texture.tex_id));
     GL_CALL(glTexParameteri(texture.target, GL_TEXTURE_MIN_FILTER, GL_LINEAR));
 
-    uniform1f("_wayfire_y_base", texture.invert_y ? 1 : 0);
-    uniform1f("_wayfire_y_mult", texture.invert_y ? -1 : 1);
+    uniform1f(priv->y_base, texture.invert_y ? 1 : 0);
+    uniform1f(priv->y_mult, texture.invert_y ? -1 : 1);
 }
 
 void program_t::deactivate()
@@ -0,0 +1,278 @@
+#include "program-cache.hpp"
+#include <wayfire/option-wrapper.hpp>
+#include <wayfire/util/log.hpp>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+#include <time.h>
+
+namespace
+{
+/* Bump when the layout of the cache files changes */
+constexpr uint32_t cache_file_version = 1;
+constexpr char cache_file_magic[4] = {'W', 'F', 'P', 'C'};
+
+struct cache_file_header_t
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t driver_length;
+    uint64_t key_length;
+    uint64_t binary_length;
+    int64_t compile_usec;
+};
+
+int64_t get_current_usec()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+}
+
+std::string get_gl_string(GLenum name)
+{
+    auto str = GL_CALL(glGetString(name));
+    return str ? reinterpret_cast<const char*>(str) : "";
+}
+
+/** Create the directory and its parents, like mkdir -p */
+bool make_directories(const std::string& path)
+{
+    for (size_t pos = 1; pos <= path.size(); pos++)
+    {
+        if (pos < path.size() && path[pos] != '/')
+            continue;
+
+        auto dir = path.substr(0, pos);
+        if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+            return false;
+    }
+
+    return true;
+}
+}
+
+namespace OpenGL
+{
+bool program_cache_t::is_enabled()
+{
+    static wf::option_wrapper_t<bool> enabled{"core/program_cache"};
+    if (!enabled)
+        return false;
+
+    if (checked_support)
+        return supported;
+
+    checked_support = true;
+
+    /* glProgramBinary is core since GLES 3.0, and drivers may still report
+     * that they support no binary formats at all */
+    int major = 0;
+    auto version = get_gl_string(GL_VERSION);
+    if (sscanf(version.c_str(), "OpenGL ES %d", &major) != 1 || major < 3)
+        return false;
+
+    GLint nr_formats = 0;
+    GL_CALL(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nr_formats));
+    if (nr_formats <= 0)
+    {
+        LOGI("GL driver supports no program binary formats, "
+             "not caching shader programs");
+        return false;
+    }
+
+    driver = get_gl_string(GL_VENDOR) + "\n" + get_gl_string(GL_RENDERER) +
+        "\n" + version;
+    supported = true;
+    return true;
+}
+
+std::string program_cache_t::get_cache_dir()
+{
+    const char *cache_home = getenv("XDG_CACHE_HOME");
+    if (cache_home && *cache_home)
+        return std::string(cache_home) + "/wayfire/programs";
+
+    const char *home = getenv("HOME");
+    if (home && *home)
+        return std::string(home) + "/.cache/wayfire/programs";
+
+    return "";
+}
+
+std::string program_cache_t::get_cache_file(const std::string& key)
+{
+    auto dir = get_cache_dir();
+    if (dir.empty())
+        return "";
+
+    std::ostringstream name;
+    name << dir << "/" << std::hex << std::hash<std::string>{}(driver + key);
+    return name.str();
+}
+
+bool program_cache_t::read_entry(const std::string& key, entry_t& entry)
+{
+    auto file = get_cache_file(key);
+    if (file.empty())
+        return false;
+
+    std::ifstream in{file, std::ios::binary};
+    cache_file_header_t header;
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)))
+        return false;
+
+    if (std::memcmp(header.magic, cache_file_magic, sizeof(header.magic)) ||
+        header.version != cache_file_version ||
+        header.driver_length != driver.size() ||
+        header.key_length != key.size())
+    {
+        return false;
+    }
+
+    /* Different sources may hash to the same file, so compare them too */
+    std::string stored_driver(header.driver_length, '\0');
+    std::string stored_key(header.key_length, '\0');
+    entry.binary.resize(header.binary_length);
+    if (!in.read(&stored_driver[0], stored_driver.size()) ||
+        !in.read(&stored_key[0], stored_key.size()) ||
+        !in.read(entry.binary.data(), entry.binary.size()))
+    {
+        return false;
+    }
+
+    entry.format = header.format;
+    entry.compile_usec = header.compile_usec;
+    return stored_driver == driver && stored_key == key;
+}
+
+void program_cache_t::write_entry(const std::string& key, const entry_t& entry)
+{
+    auto file = get_cache_file(key);
+    if (file.empty() || !make_directories(get_cache_dir()))
+        return;
+
+    cache_file_header_t header;
+    std::memcpy(header.magic, cache_file_magic, sizeof(header.magic));
+    header.version = cache_file_version;
+    header.format = entry.format;
+    header.driver_length = driver.size();
+    header.key_length = key.size();
+    header.binary_length = entry.binary.size();
+    header.compile_usec = entry.compile_usec;
+
+    /* Write to a temporary file first, so that concurrently starting
+     * instances never see a partially written entry */
+    auto tmp_file = file + ".tmp";
+    {
+        std::ofstream out{tmp_file, std::ios::binary | std::ios::trunc};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(driver.data(), driver.size());
+        out.write(key.data(), key.size());
+        out.write(entry.binary.data(), entry.binary.size());
+        if (!out)
+        {
+            LOGW("Failed to write shader program cache file ", tmp_file);
+            std::remove(tmp_file.c_str());
+            return;
+        }
+    }
+
+    std::rename(tmp_file.c_str(), file.c_str());
+}
+
+GLuint program_cache_t::load(const std::string& vertex_source,
+    const std::string& frag_source)
+{
+    if (!is_enabled())
+        return 0;
+
+    int64_t start = get_current_usec();
+    auto key = vertex_source + '\0' + frag_source;
+
+    bool from_disk = false;
+    auto it = entries.find(key);
+    if (it == entries.end())
+    {
+        entry_t entry;
+        if (!read_entry(key, entry))
+            return 0;
+
+        it = entries.emplace(key, std::move(entry)).first;
+        from_disk = true;
+    }
+
+    auto program = GL_CALL(glCreateProgram());
+    GL_CALL(glProgramBinary(program, it->second.format,
+        it->second.binary.data(), it->second.binary.size()));
+
+    GLint status = GL_FALSE;
+    GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    if (status == GL_FALSE)
+    {
+        /* For ex. the driver was updated without changing its version */
+        LOGD("Cached program binary rejected by the driver, recompiling");
+        GL_CALL(glDeleteProgram(program));
+        entries.erase(it);
+        return 0;
+    }
+
+    if (from_disk)
+        ++stats.loaded_from_disk;
+    else
+        ++stats.reused;
+
+    stats.saved_usec += it->second.compile_usec - (get_current_usec() - start);
+    return program;
+}
+
+void program_cache_t::prepare(GLuint program)
+{
+    if (is_enabled())
+    {
+        GL_CALL(glProgramParameteri(program,
+            GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE));
+    }
+}
+
+void program_cache_t::store(GLuint program, const std::string& vertex_source,
+    const std::string& frag_source, int64_t compile_usec)
+{
+    if (!is_enabled())
+        return;
+
+    GLint status = GL_FALSE, length = 0;
+    GL_CALL(glGetProgramiv(program, GL_LINK_STATUS, &status));
+    GL_CALL(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (status == GL_FALSE || length <= 0)
+        return;
+
+    entry_t entry;
+    entry.compile_usec = compile_usec;
+    entry.binary.resize(length);
+    GL_CALL(glGetProgramBinary(program, length, &length, &entry.format,
+        entry.binary.data()));
+    entry.binary.resize(length);
+
+    auto key = vertex_source + '\0' + frag_source;
+    write_entry(key, entry);
+    entries[key] = std::move(entry);
+}
+
+void program_cache_t::count_compiled(int64_t compile_usec)
+{
+    ++stats.compiled;
+    stats.compile_usec += compile_usec;
+}
+
+program_cache_t& get_program_cache()
+{
+    static program_cache_t cache;
+    return cache;
+}
+}
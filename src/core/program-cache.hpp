@@ -0,0 +1,85 @@
+#ifndef WF_PROGRAM_CACHE_HPP
+#define WF_PROGRAM_CACHE_HPP
+
+#include <wayfire/opengl.hpp>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace OpenGL
+{
+/**
+ * A cache of linked program binaries, so that the same shaders do not have
+ * to be compiled again on each output and on each start of the compositor.
+ *
+ * Binaries are kept in memory for the lifetime of the compositor, and are
+ * stored in $XDG_CACHE_HOME/wayfire/programs. Entries are keyed by the
+ * shader sources and the GL vendor, renderer and version, so that updating
+ * the driver does not load incompatible binaries. The driver may still
+ * reject a binary, in which case the program is compiled from source.
+ *
+ * All functions must be called with a current GL context.
+ */
+class program_cache_t
+{
+  public:
+    /**
+     * Create a program from a cached binary of the given sources.
+     *
+     * @return The linked program, or 0 if there is no usable binary.
+     */
+    GLuint load(const std::string& vertex_source,
+        const std::string& frag_source);
+
+    /**
+     * Must be called before linking a program which will be passed to
+     * store(), so that the driver keeps its binary around.
+     */
+    void prepare(GLuint program);
+
+    /**
+     * Store the binary of the linked program in the cache.
+     *
+     * @param compile_usec The time it took to compile and link the program,
+     *   used to report the time saved when it is loaded later.
+     */
+    void store(GLuint program, const std::string& vertex_source,
+        const std::string& frag_source, int64_t compile_usec);
+
+    const program_cache_stats_t& get_stats() const
+    {
+        return stats;
+    }
+
+    /** Record the compilation of a program which was not in the cache. */
+    void count_compiled(int64_t compile_usec);
+
+  private:
+    struct entry_t
+    {
+        GLenum format;
+        int64_t compile_usec;
+        std::vector<char> binary;
+    };
+
+    /* Binaries used by this process, keyed by their sources */
+    std::unordered_map<std::string, entry_t> entries;
+    program_cache_stats_t stats;
+
+    bool checked_support = false;
+    bool supported = false;
+    std::string driver;
+
+    bool is_enabled();
+    std::string get_cache_dir();
+    std::string get_cache_file(const std::string& key);
+
+    bool read_entry(const std::string& key, entry_t& entry);
+    void write_entry(const std::string& key, const entry_t& entry);
+};
+
+/** Get the program cache, shared by all outputs */
+program_cache_t& get_program_cache();
+}
+
+#endif /* end of include guard: WF_PROGRAM_CACHE_HPP */
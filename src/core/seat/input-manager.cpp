@@ -22,6 +22,7 @@ extern "C"
 #include "switch.hpp"
 #include "tablet.hpp"
 #include "pointing-device.hpp"
+#include "view-hit-index.hpp"
 
 bool input_manager::is_touch_enabled()
 {
@@ -177,6 +178,7 @@ input_manager::input_manager()
 
     config_updated = [=] (wf::signal_data_t *)
     {
+        binding_cache.clear();
         for (auto& dev : input_devices)
             dev->update_options();
         for (auto& kbd : keyboards)
@@ -293,20 +295,11 @@ wf::surface_interface_t* input_manager::input_surface_at(wf::pointf_t global,
     global.x -= og.x;
     global.y -= og.y;
 
-    for (auto& v : output->workspace->get_views_in_layer(wf::VISIBLE_LAYERS))
-    {
-        for (auto& view : v->enumerate_views())
-        {
-            if (can_focus_surface(view.get()))
-            {
-                auto surface = view->map_input_coordinates(global, local);
-                if (surface)
-                    return surface;
-            }
-        }
-    }
+    if (!output->has_data<wf::view_hit_index_t>())
+        output->store_data(std::make_unique<wf::view_hit_index_t>(output));
 
-    return nullptr;
+    return output->get_data<wf::view_hit_index_t>()->surface_at(global, local,
+        [=] (wayfire_view view) { return can_focus_surface(view.get()); });
 }
 
 void input_manager::set_exclusive_focus(wl_client *client)
@@ -330,6 +323,11 @@ void input_manager::set_exclusive_focus(wl_client *client)
 
 /* add/remove bindings */
 
+wf::binding_t::~binding_t()
+{
+    value->rem_updated_handler(&on_option_updated);
+}
+
 wf::binding_t* input_manager::new_binding(wf_binding_type type,
     std::shared_ptr<wf::config::option_base_t> value,
     wf::output_t *output, void *callback)
@@ -342,9 +340,12 @@ wf::binding_t* input_manager::new_binding(wf_binding_type type,
     binding->value = value;
     binding->output = output;
     binding->call.raw = callback;
+    binding->on_option_updated = [=] () { binding_cache.clear(); };
+    value->add_updated_handler(&binding->on_option_updated);
 
     auto raw = binding.get();
     bindings[type].push_back(std::move(binding));
+    binding_cache.clear();
 
     return raw;
 }
@@ -364,6 +365,8 @@ void input_manager::rem_binding(binding_criteria criteria)
             }
         }
     }
+
+    binding_cache.clear();
 }
 
 void input_manager::rem_binding(wf::binding_t *binding)
@@ -383,6 +386,77 @@ void input_manager::free_output_bindings(wf::output_t *output)
     });
 }
 
+bool input_manager::binding_matches(wf::binding_t *binding,
+    const binding_lookup_t& lookup)
+{
+    if (binding->output != lookup.output)
+        return false;
+
+    switch (lookup.type)
+    {
+        case WF_BINDING_KEY:
+        case WF_BINDING_AXIS:
+        case WF_BINDING_TOUCH:
+        {
+            auto as_key = std::dynamic_pointer_cast<
+                wf::config::option_t<wf::keybinding_t>> (binding->value);
+            assert(as_key);
+
+            return as_key->get_value() ==
+                wf::keybinding_t{lookup.mods, lookup.code};
+        }
+
+        case WF_BINDING_BUTTON:
+        {
+            auto as_button = std::dynamic_pointer_cast<
+                wf::config::option_t<wf::buttonbinding_t>> (binding->value);
+            assert(as_button);
+
+            return as_button->get_value() ==
+                wf::buttonbinding_t{lookup.mods, lookup.code};
+        }
+
+        case WF_BINDING_ACTIVATOR:
+        {
+            auto as_activator = std::dynamic_pointer_cast<
+                wf::config::option_t<wf::activatorbinding_t>> (binding->value);
+            assert(as_activator);
+
+            if (lookup.is_button)
+            {
+                return as_activator->get_value().has_match(
+                    wf::buttonbinding_t{lookup.mods, lookup.code});
+            }
+
+            return as_activator->get_value().has_match(
+                wf::keybinding_t{lookup.mods, lookup.code});
+        }
+
+        default:
+            return false;
+    }
+}
+
+const std::vector<wf::binding_t*>& input_manager::get_matching_bindings(
+    wf_binding_type type, uint32_t mods, uint32_t code, bool is_button)
+{
+    binding_lookup_t lookup{type, is_button,
+        wf::get_core().get_active_output(), mods, code};
+
+    auto it = binding_cache.find(lookup);
+    if (it != binding_cache.end())
+        return it->second;
+
+    auto& matching = binding_cache[lookup];
+    for (auto& binding : bindings[type])
+    {
+        if (binding_matches(binding.get(), lookup))
+            matching.push_back(binding.get());
+    }
+
+    return matching;
+}
+
 bool input_manager::check_button_bindings(uint32_t button)
 {
     std::vector<std::function<bool()>> callbacks;
@@ -390,41 +464,26 @@ bool input_manager::check_button_bindings(uint32_t button)
     auto oc = wf::get_core().get_active_output()->get_cursor_position();
     auto mod_state = get_modifiers();
 
-    for (auto& binding : bindings[WF_BINDING_BUTTON])
+    for (auto& binding :
+        get_matching_bindings(WF_BINDING_BUTTON, mod_state, button))
     {
-        auto as_button = std::dynamic_pointer_cast<
-            wf::config::option_t<wf::buttonbinding_t>> (binding->value);
-        assert(as_button);
-
-        if (binding->output == wf::get_core().get_active_output() &&
-            wf::buttonbinding_t{mod_state, button} == as_button->get_value())
-        {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda */
-            auto callback = binding->call.button;
-            callbacks.push_back([=] () {
-                return (*callback) (button, oc.x, oc.y);
-            });
-        }
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda */
+        auto callback = binding->call.button;
+        callbacks.push_back([=] () {
+            return (*callback) (button, oc.x, oc.y);
+        });
     }
 
-    for (auto& binding : bindings[WF_BINDING_ACTIVATOR])
+    for (auto& binding :
+        get_matching_bindings(WF_BINDING_ACTIVATOR, mod_state, button, true))
     {
-        auto as_activator = std::dynamic_pointer_cast<
-            wf::config::option_t<wf::activatorbinding_t>> (binding->value);
-        assert(as_activator);
-
-        if (binding->output == wf::get_core().get_active_output() &&
-            as_activator->get_value().has_match(
-                wf::buttonbinding_t{mod_state, button}))
-        {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda */
-            auto callback = binding->call.activator;
-            callbacks.push_back([=] () {
-                return (*callback) (wf::ACTIVATOR_SOURCE_BUTTONBINDING, button);
-            });
-        }
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda */
+        auto callback = binding->call.activator;
+        callbacks.push_back([=] () {
+            return (*callback) (wf::ACTIVATOR_SOURCE_BUTTONBINDING, button);
+        });
     }
 
     bool binding_handled = false;
@@ -437,19 +496,10 @@ bool input_manager::check_button_bindings(uint32_t button)
 bool input_manager::check_axis_bindings(wlr_event_pointer_axis *ev)
 {
     std::vector<wf::axis_callback*> callbacks;
-    auto mod_state = get_modifiers();
-
-    for (auto& binding : bindings[WF_BINDING_AXIS])
+    for (auto& binding :
+        get_matching_bindings(WF_BINDING_AXIS, get_modifiers(), 0))
     {
-        auto as_key = std::dynamic_pointer_cast<
-            wf::config::option_t<wf::keybinding_t>> (binding->value);
-        assert(as_key);
-
-        if (binding->output == wf::get_core().get_active_output() &&
-            as_key->get_value() == wf::keybinding_t{mod_state, 0})
-        {
-            callbacks.push_back(binding->call.axis);
-        }
+        callbacks.push_back(binding->call.axis);
     }
 
     for (auto call : callbacks)
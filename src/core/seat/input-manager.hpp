@@ -2,6 +2,7 @@
 #define INPUT_MANAGER_HPP
 
 #include <map>
+#include <unordered_map>
 #include <vector>
 #include <chrono>
 
@@ -53,6 +54,42 @@ struct wf::binding_t
         wf::gesture_callback *gesture;
         wf::activator_callback *activator;
     } call;
+
+    /* Invalidates the cached binding lookups when the option changes */
+    wf::config::option_base_t::updated_callback_t on_option_updated;
+
+    ~binding_t();
+};
+
+/**
+ * Describes an input event for looking up the bindings which it triggers.
+ */
+struct binding_lookup_t
+{
+    wf_binding_type type;
+    /* For activator bindings, whether the event is a button press */
+    bool is_button;
+    wf::output_t *output;
+    uint32_t mods;
+    /* The key or button, 0 for axis and touch bindings */
+    uint32_t code;
+
+    bool operator == (const binding_lookup_t& other) const
+    {
+        return type == other.type && is_button == other.is_button &&
+            output == other.output && mods == other.mods && code == other.code;
+    }
+};
+
+struct binding_lookup_hash_t
+{
+    size_t operator () (const binding_lookup_t& lookup) const
+    {
+        size_t hash = std::hash<wf::output_t*>()(lookup.output);
+        hash = hash * 31 + lookup.type * 2 + lookup.is_button;
+        hash = hash * 31 + lookup.mods;
+        return hash * 31 + lookup.code;
+    }
 };
 
 using wf_binding_ptr = std::unique_ptr<wf::binding_t>;
@@ -75,6 +112,18 @@ class input_manager
         using binding_criteria = std::function<bool(wf::binding_t*)>;
         void rem_binding(binding_criteria criteria);
 
+        /* The bindings matching each looked up event, in the order in which
+         * they were added. Entries are filled on first use and the whole
+         * cache is dropped when bindings are added, removed or changed. */
+        std::unordered_map<binding_lookup_t, std::vector<wf::binding_t*>,
+            binding_lookup_hash_t> binding_cache;
+        bool binding_matches(wf::binding_t *binding,
+            const binding_lookup_t& lookup);
+        /** Get the bindings on the active output which match the event */
+        const std::vector<wf::binding_t*>& get_matching_bindings(
+            wf_binding_type type, uint32_t mods, uint32_t code,
+            bool is_button = false);
+
         bool is_touch_enabled();
 
         void create_seat();
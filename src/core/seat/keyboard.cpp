@@ -180,43 +180,28 @@ std::vector<std::function<bool()>> input_manager::match_keys(uint32_t mod_state,
 
     uint32_t actual_key = key == 0 ? mod_binding_key : key;
 
-    for (auto& binding : bindings[WF_BINDING_KEY])
+    for (auto& binding : get_matching_bindings(WF_BINDING_KEY, mod_state, key))
     {
-        auto as_key = std::dynamic_pointer_cast<
-            wf::config::option_t<wf::keybinding_t>> (binding->value);
-        assert(as_key);
-
-        if (as_key->get_value() == wf::keybinding_t{mod_state, key} &&
-            binding->output == wf::get_core().get_active_output())
-        {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda */
-            auto callback = binding->call.key;
-            callbacks.push_back([actual_key, callback] () {
-                return (*callback) (actual_key);
-            });
-        }
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda */
+        auto callback = binding->call.key;
+        callbacks.push_back([actual_key, callback] () {
+            return (*callback) (actual_key);
+        });
     }
 
-    for (auto& binding : bindings[WF_BINDING_ACTIVATOR])
+    for (auto& binding :
+        get_matching_bindings(WF_BINDING_ACTIVATOR, mod_state, key))
     {
-        auto as_activator = std::dynamic_pointer_cast<
-            wf::config::option_t<wf::activatorbinding_t>> (binding->value);
-        assert(as_activator);
-
-        if (as_activator->get_value().has_match(wf::keybinding_t{mod_state, key}) &&
-            binding->output == wf::get_core().get_active_output())
-        {
-            /* We must be careful because the callback might be erased,
-             * so force copy the callback into the lambda
-             *
-             * Also, do not send keys for modifier bindings */
-            auto callback = binding->call.activator;
-            callbacks.push_back([=] () {
-                return (*callback) (wf::ACTIVATOR_SOURCE_KEYBINDING,
-                    mod_from_key(seat, actual_key) ? 0 : actual_key);
-            });
-        }
+        /* We must be careful because the callback might be erased,
+         * so force copy the callback into the lambda
+         *
+         * Also, do not send keys for modifier bindings */
+        auto callback = binding->call.activator;
+        callbacks.push_back([=] () {
+            return (*callback) (wf::ACTIVATOR_SOURCE_KEYBINDING,
+                mod_from_key(seat, actual_key) ? 0 : actual_key);
+        });
     }
 
     return callbacks;
@@ -450,18 +450,8 @@ void input_manager::check_touch_bindings(int x, int y)
 {
     uint32_t mods = get_modifiers();
     std::vector<wf::touch_callback*> calls;
-    for (auto& binding : bindings[WF_BINDING_TOUCH])
-    {
-        auto as_key = std::dynamic_pointer_cast<
-            wf::config::option_t<wf::keybinding_t>> (binding->value);
-        assert(as_key);
-
-        if (as_key->get_value() == wf::keybinding_t{mods, 0} &&
-            binding->output == wf::get_core().get_active_output())
-        {
-            calls.push_back(binding->call.touch);
-        }
-    }
+    for (auto& binding : get_matching_bindings(WF_BINDING_TOUCH, mods, 0))
+        calls.push_back(binding->call.touch);
 
     for (auto call : calls)
         (*call)(x, y);
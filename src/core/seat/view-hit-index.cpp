@@ -0,0 +1,94 @@
+#include "view-hit-index.hpp"
+#include "../core-impl.hpp"
+#include <wayfire/output.hpp>
+#include <wayfire/workspace-manager.hpp>
+#include <algorithm>
+#include <cmath>
+
+wf::view_hit_index_t::view_hit_index_t(wf::output_t *output)
+{
+    this->output = output;
+
+    for (auto signal : {"layer-attach-view", "layer-detach-view",
+        "attach-view", "detach-view", "map-view", "unmap-view",
+        "view-disappeared", "focus-view", "viewport-changed"})
+    {
+        output->connect_signal(signal, &on_views_changed);
+    }
+}
+
+void wf::view_hit_index_t::invalidate()
+{
+    dirty = true;
+}
+
+void wf::view_hit_index_t::rebuild()
+{
+    serial = wf::get_core_impl().visibility_serial;
+    entries.clear();
+    for (auto& v : output->workspace->get_views_in_layer(wf::VISIBLE_LAYERS))
+    {
+        for (auto& view : v->enumerate_views())
+        {
+            /* Transformers may round the bounding box inwards, so be a bit
+             * more generous when culling */
+            auto bbox = view->get_bounding_box();
+            entries.push_back({view, {bbox.x - 1, bbox.y - 1,
+                bbox.width + 2, bbox.height + 2}});
+        }
+    }
+
+    grid_box = output->get_relative_geometry();
+    grid_width = std::max(1, (grid_box.width + CELL_SIZE - 1) / CELL_SIZE);
+    grid_height = std::max(1, (grid_box.height + CELL_SIZE - 1) / CELL_SIZE);
+
+    cells.resize(grid_width * grid_height);
+    for (auto& cell : cells)
+        cell.clear();
+
+    for (uint32_t i = 0; i < entries.size(); i++)
+    {
+        auto box = wf::geometry_intersection(entries[i].bbox, grid_box);
+        if (box.width <= 0 || box.height <= 0)
+            continue;
+
+        int x1 = (box.x - grid_box.x) / CELL_SIZE;
+        int y1 = (box.y - grid_box.y) / CELL_SIZE;
+        int x2 = (box.x + box.width - 1 - grid_box.x) / CELL_SIZE;
+        int y2 = (box.y + box.height - 1 - grid_box.y) / CELL_SIZE;
+
+        for (int y = y1; y <= y2; y++)
+        {
+            for (int x = x1; x <= x2; x++)
+                cells[y * grid_width + x].push_back(i);
+        }
+    }
+
+    dirty = false;
+}
+
+wf::surface_interface_t *wf::view_hit_index_t::surface_at(wf::pointf_t point,
+    wf::pointf_t& local, const filter_t& filter)
+{
+    if (dirty || (serial != wf::get_core_impl().visibility_serial))
+        rebuild();
+
+    int x = std::floor((point.x - grid_box.x) / CELL_SIZE);
+    int y = std::floor((point.y - grid_box.y) / CELL_SIZE);
+    if (x < 0 || y < 0 || x >= grid_width || y >= grid_height)
+        return nullptr;
+
+    /* Views are stored topmost first, so the first hit is the topmost */
+    for (auto i : cells[y * grid_width + x])
+    {
+        auto& entry = entries[i];
+        if (!(entry.bbox & point) || !filter(entry.view))
+            continue;
+
+        auto surface = entry.view->map_input_coordinates(point, local);
+        if (surface)
+            return surface;
+    }
+
+    return nullptr;
+}
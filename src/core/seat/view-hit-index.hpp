@@ -0,0 +1,82 @@
+#ifndef WF_SEAT_VIEW_HIT_INDEX_HPP
+#define WF_SEAT_VIEW_HIT_INDEX_HPP
+
+#include <functional>
+#include <vector>
+#include <wayfire/object.hpp>
+#include <wayfire/view.hpp>
+
+namespace wf
+{
+/**
+ * A spatial index of the views on an output, used to find the topmost
+ * surface at a given point without walking all views on the output.
+ *
+ * The output is divided into a grid of cells, and each cell contains the
+ * views whose bounding box intersects it, in stacking order. The index is
+ * rebuilt lazily on the first query after it has been invalidated.
+ *
+ * Core bumps its visibility serial whenever views are restacked, moved,
+ * resized, or transformers are added or removed, so the index is outdated
+ * when the serial changes. Transformers can also change without being
+ * replaced, which is only visible as damage, so damage of a transformed
+ * view invalidates the index too, see view_damage_raw(). Finally, the index
+ * is invalidated when views are added to or removed from the output's
+ * layers, mapped, unmapped or focused, and when the workspace changes.
+ *
+ * The index is stored as custom data on the output.
+ */
+class view_hit_index_t : public wf::custom_data_t
+{
+  public:
+    view_hit_index_t(wf::output_t *output);
+
+    /** Check whether a view can receive input. */
+    using filter_t = std::function<bool(wayfire_view)>;
+
+    /**
+     * Find the topmost surface which accepts input at the given point.
+     *
+     * @param point The point in output-local coordinates.
+     * @param local Set to the coordinates of the point relative to the
+     *   returned surface.
+     * @param filter Views which don't pass the filter are skipped.
+     *
+     * @return The surface at the point, or null if there is no such surface.
+     */
+    wf::surface_interface_t *surface_at(wf::pointf_t point,
+        wf::pointf_t& local, const filter_t& filter);
+
+    /** Mark the index as outdated. */
+    void invalidate();
+
+  private:
+    static constexpr int CELL_SIZE = 128;
+
+    wf::output_t *output;
+    bool dirty = true;
+    /* The visibility serial of core when the index was built */
+    uint64_t serial;
+
+    struct entry_t
+    {
+        wayfire_view view;
+        wf::geometry_t bbox;
+    };
+
+    /* All views in stacking order, topmost first */
+    std::vector<entry_t> entries;
+    /* For each cell, the indices in entries of the views intersecting it */
+    std::vector<std::vector<uint32_t>> cells;
+    wf::geometry_t grid_box;
+    int grid_width, grid_height;
+
+    void rebuild();
+
+    wf::signal_connection_t on_views_changed{[this] (wf::signal_data_t*) {
+        invalidate();
+    }};
+};
+}
+
+#endif /* end of include guard: WF_SEAT_VIEW_HIT_INDEX_HPP */
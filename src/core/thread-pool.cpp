@@ -0,0 +1,170 @@
+#include "wayfire/thread-pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class wf::thread_pool_t::impl
+{
+  public:
+    std::mutex mutex;
+    std::condition_variable task_available;
+    std::deque<task_t> tasks;
+    std::vector<std::thread> workers;
+    bool stopping = false;
+
+    size_t get_wanted_workers() const
+    {
+        /* The thread which submits work usually takes part in it too */
+        size_t cores = std::thread::hardware_concurrency();
+        return std::max<size_t>(1, cores > 1 ? cores - 1 : 1);
+    }
+
+    /* Must be called with the mutex held */
+    void start_workers()
+    {
+        if (!workers.empty())
+            return;
+
+        size_t count = get_wanted_workers();
+        for (size_t i = 0; i < count; i++)
+            workers.emplace_back([=] () { worker_loop(); });
+    }
+
+    void worker_loop()
+    {
+        while (true)
+        {
+            task_t task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                task_available.wait(lock,
+                    [=] () { return stopping || !tasks.empty(); });
+
+                if (tasks.empty())
+                    return;
+
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+
+    ~impl()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+
+        task_available.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    }
+};
+
+wf::thread_pool_t::thread_pool_t()
+{
+    this->priv = std::make_unique<impl>();
+}
+
+wf::thread_pool_t::~thread_pool_t() = default;
+
+void wf::thread_pool_t::submit(task_t task)
+{
+    {
+        std::lock_guard<std::mutex> lock(priv->mutex);
+        priv->start_workers();
+        priv->tasks.push_back(std::move(task));
+    }
+
+    priv->task_available.notify_one();
+}
+
+namespace
+{
+/* The state of a parallel_for, shared with the helper tasks, which may still
+ * be queued after the parallel_for has returned */
+struct parallel_for_state_t
+{
+    wf::thread_pool_t::range_func_t func;
+    size_t start, end, chunk_size, nr_chunks;
+
+    std::atomic<size_t> next_chunk{0};
+    size_t finished_chunks = 0;
+    std::mutex mutex;
+    std::condition_variable all_finished;
+
+    /** Process chunks until there are no more left */
+    void run_chunks()
+    {
+        size_t finished = 0;
+        size_t chunk;
+        while ((chunk = next_chunk++) < nr_chunks)
+        {
+            size_t chunk_start = start + chunk * chunk_size;
+            func(chunk_start, std::min(end, chunk_start + chunk_size));
+            ++finished;
+        }
+
+        if (finished == 0)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        finished_chunks += finished;
+        if (finished_chunks == nr_chunks)
+            all_finished.notify_all();
+    }
+};
+}
+
+void wf::thread_pool_t::parallel_for(size_t start, size_t end,
+    range_func_t func, size_t min_chunk)
+{
+    if (start >= end)
+        return;
+
+    size_t total = end - start;
+    size_t max_chunks = get_worker_count() + 1;
+    size_t nr_chunks = std::min(max_chunks,
+        (total + min_chunk - 1) / std::max<size_t>(min_chunk, 1));
+
+    if (nr_chunks <= 1)
+    {
+        func(start, end);
+        return;
+    }
+
+    auto state = std::make_shared<parallel_for_state_t>();
+    state->func = std::move(func);
+    state->start = start;
+    state->end = end;
+    state->chunk_size = (total + nr_chunks - 1) / nr_chunks;
+    state->nr_chunks = (total + state->chunk_size - 1) / state->chunk_size;
+
+    for (size_t i = 1; i < state->nr_chunks; i++)
+        submit([state] () { state->run_chunks(); });
+
+    state->run_chunks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->all_finished.wait(lock,
+        [&] () { return state->finished_chunks == state->nr_chunks; });
+}
+
+size_t wf::thread_pool_t::get_worker_count() const
+{
+    return priv->get_wanted_workers();
+}
+
+wf::thread_pool_t& wf::get_thread_pool()
+{
+    static thread_pool_t pool;
+    return pool;
+}
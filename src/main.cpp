@@ -10,7 +10,6 @@
 
 #include "debug-func.hpp"
 #include "main.hpp"
-#include "wayfire/nonstd/safe-list.hpp"
 #include <wayfire/config/file.hpp>
 
 extern "C"
@@ -28,6 +27,7 @@ extern "C"
 #include "core/core-impl.hpp"
 #include "view/view-impl.hpp"
 #include "wayfire/output.hpp"
+#include "wayfire/opengl.hpp"
 
 wf_runtime_config runtime_config;
 
@@ -121,19 +121,6 @@ wlr_renderer *add_egl_depth_renderer(wlr_egl *egl, EGLenum platform,
     return renderer;
 }
 
-namespace wf
-{
-    namespace _safe_list_detail
-    {
-        wl_event_loop* event_loop;
-        void idle_cleanup_func(void *data)
-        {
-            auto priv = reinterpret_cast<std::function<void()>*> (data);
-            (*priv)();
-        }
-    }
-}
-
 static bool drop_permissions(void)
 {
     if (getuid() != geteuid() || getgid() != getegid())
@@ -261,10 +248,7 @@ int main(int argc, char *argv[])
 #endif
 
     LOGI("Starting wayfire");
-    /* First create display and initialize safe-list's event loop, so that
-     * wf objects (which depend on safe-list) can work */
     auto display = wl_display_create();
-    wf::_safe_list_detail::event_loop = wl_display_get_event_loop(display);
 
     auto& core = wf::get_core_impl();
 
@@ -312,6 +296,12 @@ int main(int argc, char *argv[])
         return -1;
     }
 
+    auto cache_stats = OpenGL::get_program_cache_stats();
+    LOGI("shader programs: ", cache_stats.compiled, " compiled in ",
+        cache_stats.compile_usec / 1000, "ms, ", cache_stats.loaded_from_disk,
+        " loaded from cache, ", cache_stats.reused, " reused, saved ",
+        cache_stats.saved_usec / 1000, "ms");
+
     LOGI("running at server ", server_name);
     setenv("WAYLAND_DISPLAY", server_name, 1);
     wf::xwayland_set_seat(core.get_current_seat());
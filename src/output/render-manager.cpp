@@ -4,11 +4,15 @@
 #include "../core/core-impl.hpp"
 #include "wayfire/util.hpp"
 #include "wayfire/workspace-manager.hpp"
+#include "wayfire/view-transform.hpp"
 #include "../core/seat/input-manager.hpp"
 #include "../core/opengl-priv.hpp"
 #include "wayfire/debug.hpp"
 #include "../main.hpp"
 #include <algorithm>
+#include <cmath>
+#include <unordered_set>
+#include <vector>
 #include <wayfire/nonstd/reverse.hpp>
 #include <wayfire/nonstd/safe-list.hpp>
 #include <wayfire/util/log.hpp>
@@ -74,6 +78,24 @@ struct output_damage_t
         wlr_output_damage_add_box(damage_manager, &scaled_box);
     }
 
+    /**
+     * Record the given region as repainted in the current frame, so that it is
+     * part of the damage history used for buffers with an age. In contrast to
+     * damage(), this doesn't schedule another frame.
+     *
+     * @param region The repainted region, in output-local coordinates.
+     */
+    void add_repainted(const wf::region_t& region)
+    {
+        if (region.empty() || !damage_manager)
+            return;
+
+        auto scaled_region = region * wo->handle->scale;
+        scaled_region &= get_wlr_damage_box();
+        pixman_region32_union(&damage_manager->current,
+            &damage_manager->current, scaled_region.to_pixman());
+    }
+
     /**
      * Make the output current. This sets its EGL context as current, checks
      * whether there is any damage and makes sure frame_damage contains all the
@@ -235,80 +257,335 @@ struct effect_hook_manager_t
     }
 };
 
+static const char *post_shader_vertex_source = R"(
+#version 100
+
+attribute mediump vec2 position;
+varying highp vec2 uvpos;
+
+void main() {
+    gl_Position = vec4(position.xy, 0.0, 1.0);
+    uvpos = (position.xy + vec2(1.0, 1.0)) / 2.0;
+})";
+
 /**
  * A class to manage and run postprocessing effects
  */
 struct postprocessing_manager_t
 {
-    using post_container_t = wf::safe_list_t<post_hook_t*>;
+    struct post_effect_t
+    {
+        post_hook_t *hook;
+        post_damage_t damage;
+    };
+
+    using post_container_t = wf::safe_list_t<post_effect_t>;
     post_container_t post_effects;
-    wf::framebuffer_base_t post_buffers[3];
+    /* The buffer to which other operations render to, followed by the
+     * destination buffers of the effects. The last effect renders directly
+     * to the output, so it needs no buffer. */
+    std::vector<wf::framebuffer_base_t> post_buffers;
     /* Buffer to which other operations render to */
     static constexpr uint32_t default_out_buffer = 0;
 
+    /* Whether the buffers have been (re)created and their contents are
+     * invalid */
+    bool buffers_damaged = true;
+    /* The damage of the destination of the running effect, in framebuffer
+     * coordinates */
+    wf::region_t current_damage;
+
+    /* Post shaders are run together as a single effect in the chain, at the
+     * position where the first of them was added */
+    std::vector<post_shader_t*> post_shaders;
+    post_hook_t post_shaders_hook = [=] (const wf::framebuffer_base_t& source,
+        const wf::framebuffer_base_t& destination)
+    {
+        run_post_shaders(source, destination);
+    };
+
+    /* The program which runs all post shaders, compiled on demand */
+    OpenGL::program_t post_shaders_program;
+    bool post_shaders_changed = false;
+
     output_t *output;
     uint32_t output_width, output_height;
     postprocessing_manager_t(output_t *output)
     {
         this->output = output;
+        post_buffers.resize(1);
+        post_buffers[default_out_buffer].owner = "postprocessing";
+    }
+
+    ~postprocessing_manager_t()
+    {
+        OpenGL::render_begin();
+        post_shaders_program.free_resources();
+        OpenGL::render_end();
     }
 
     void allocate(int width, int height)
     {
+        size_t nr_buffers = std::max<size_t>(post_effects.size(), 1);
+        if (post_buffers.size() > nr_buffers)
+        {
+            /* Effects have been removed */
+            OpenGL::render_begin();
+            for (size_t i = nr_buffers; i < post_buffers.size(); i++)
+                post_buffers[i].release();
+            OpenGL::render_end();
+            post_buffers.resize(nr_buffers);
+        }
+
         if (post_effects.size() == 0)
             return;
 
         output_width = width;
         output_height = height;
+        post_buffers.resize(nr_buffers);
 
         OpenGL::render_begin();
-        post_buffers[default_out_buffer].allocate(width, height);
+        for (auto& buffer : post_buffers)
+        {
+            if (buffer.viewport_width == width &&
+                buffer.viewport_height == height)
+            {
+                continue;
+            }
+
+            buffer.owner = "postprocessing";
+            buffers_damaged |= buffer.allocate(width, height);
+        }
         OpenGL::render_end();
     }
 
-    void add_post(post_hook_t* hook)
+    void add_post(post_hook_t* hook, post_damage_t damage)
     {
-        post_effects.push_back(hook);
+        post_effects.push_back({hook, damage});
         output->render->damage_whole_idle();
     }
 
     void rem_post(post_hook_t *hook)
     {
-        post_effects.remove_all(hook);
+        post_effects.remove_if([=] (const post_effect_t& effect) {
+            return effect.hook == hook;
+        });
+        output->render->damage_whole_idle();
+    }
+
+    void add_post_shader(post_shader_t *shader)
+    {
+        if (post_shaders.empty())
+            add_post(&post_shaders_hook, {POST_DAMAGE_IDENTITY});
+
+        post_shaders.push_back(shader);
+        post_shaders_changed = true;
         output->render->damage_whole_idle();
     }
 
-    /* Run all postprocessing effects, rendering to alternating buffers and
-     * finally to the screen.
+    void rem_post_shader(post_shader_t *shader)
+    {
+        auto it = std::find(post_shaders.begin(), post_shaders.end(), shader);
+        if (it == post_shaders.end())
+            return;
+
+        post_shaders.erase(it);
+        post_shaders_changed = true;
+        if (post_shaders.empty())
+            rem_post(&post_shaders_hook);
+
+        output->render->damage_whole_idle();
+    }
+
+    /**
+     * Generate and compile a program which applies all post shaders in the
+     * order they were added.
+     *
+     * @return Whether the program was compiled successfully.
+     */
+    bool compile_post_shaders()
+    {
+        std::string source = "#version 100\n@builtin_ext@\n"
+            "precision mediump float;\n@builtin@\n"
+            "varying highp vec2 uvpos;\n";
+        for (auto& shader : post_shaders)
+            source += shader->source + "\n";
+
+        source += "void main()\n{\n    vec4 color = get_pixel(uvpos);\n";
+        for (auto& shader : post_shaders)
+            source += "    color = " + shader->function_name + "(color);\n";
+        source += "    gl_FragColor = color;\n}\n";
+
+        post_shaders_program.compile(post_shader_vertex_source, source);
+
+        GLint status = GL_FALSE;
+        GLuint id = post_shaders_program.get_program_id(wf::TEXTURE_TYPE_RGBA);
+        GL_CALL(glGetProgramiv(id, GL_LINK_STATUS, &status));
+        if (status == GL_FALSE)
+        {
+            LOGE("Failed to link the post shaders, they will be disabled");
+            post_shaders_program.free_resources();
+            return false;
+        }
+
+        return true;
+    }
+
+    /**
+     * Apply all post shaders in a single pass over the damaged region.
+     */
+    void run_post_shaders(const wf::framebuffer_base_t& source,
+        const wf::framebuffer_base_t& destination)
+    {
+        OpenGL::render_begin(destination);
+        if (post_shaders_changed)
+        {
+            compile_post_shaders();
+            post_shaders_changed = false;
+        }
+
+        if (!post_shaders_program.get_program_id(wf::TEXTURE_TYPE_RGBA))
+        {
+            /* Pass the image through unchanged */
+            GL_CALL(glBindFramebuffer(GL_READ_FRAMEBUFFER, source.fb));
+            GL_CALL(glBlitFramebuffer(0, 0, output_width, output_height,
+                0, 0, output_width, output_height,
+                GL_COLOR_BUFFER_BIT, GL_NEAREST));
+            OpenGL::render_end();
+            return;
+        }
+
+        static const float vertex_data[] = {
+            -1.0f, -1.0f,
+            1.0f, -1.0f,
+            1.0f,  1.0f,
+            -1.0f,  1.0f
+        };
+
+        post_shaders_program.use(wf::TEXTURE_TYPE_RGBA);
+        post_shaders_program.set_active_texture(wf::texture_t{source.tex});
+        post_shaders_program.attrib_pointer("position", 2, 0, vertex_data);
+        for (auto& shader : post_shaders)
+        {
+            if (shader->set_uniforms)
+                shader->set_uniforms(post_shaders_program);
+        }
+
+        GL_CALL(glDisable(GL_BLEND));
+        for (const auto& rect : current_damage)
+        {
+            destination.scissor(wlr_box_from_pixman_box(rect));
+            GL_CALL(glDrawArrays(GL_TRIANGLE_FAN, 0, 4));
+        }
+
+        GL_CALL(glEnable(GL_BLEND));
+        post_shaders_program.deactivate();
+        OpenGL::render_end();
+    }
+
+    /**
+     * Calculate the damage on the destination of an effect.
+     *
+     * @param effect The effect.
+     * @param damage The damage on the source of the effect.
+     * @param output_box The extents of the output in damage coordinates.
+     */
+    static wf::region_t propagate_damage(const post_effect_t& effect,
+        const wf::region_t& damage, wlr_box output_box)
+    {
+        switch (effect.damage.type)
+        {
+            case POST_DAMAGE_IDENTITY:
+                return damage;
+
+            case POST_DAMAGE_PADDED:
+            {
+                int padding = effect.damage.padding;
+                wf::region_t padded;
+                for (const auto& rect : damage)
+                {
+                    padded |= wlr_box{rect.x1 - padding, rect.y1 - padding,
+                        rect.x2 - rect.x1 + 2 * padding,
+                        rect.y2 - rect.y1 + 2 * padding};
+                }
+
+                return padded & output_box;
+            }
+
+            case POST_DAMAGE_FULL:
+                return output_box;
+        }
+
+        return output_box;
+    }
+
+    /**
+     * Convert damage from the coordinates used for swapping buffers to
+     * framebuffer coordinates.
+     */
+    wf::region_t get_framebuffer_damage(const wf::region_t& damage)
+    {
+        int w, h;
+        wlr_output_transformed_resolution(output->handle, &w, &h);
+
+        wf::region_t result = damage;
+        wl_output_transform transform =
+            wlr_output_transform_invert(output->handle->transform);
+        wlr_region_transform(result.to_pixman(), result.to_pixman(),
+            transform, w, h);
+
+        return result;
+    }
+
+    /* Run all postprocessing effects, rendering to their buffers and finally
+     * to the screen.
      *
-     * NB: 2 buffers just aren't enough. We render to the zero buffer, and then
-     * we alternately render to the second and the third. The reason: We track
-     * damage. So, we need to keep the whole buffer each frame. */
-    void run_post_effects()
+     * Each effect renders to its own buffer, so that the parts of the buffers
+     * which are not damaged stay valid between frames. Effects run only on
+     * the part of the output which is damaged after the preceding effects,
+     * and not at all if there is no such part.
+     *
+     * @param damage The damage of the output image, in the coordinates used
+     *   for swapping buffers. Updated to the damage of the final image.
+     * @param output_box The extents of the output in the same coordinates. */
+    void run_post_effects(wf::region_t& damage, wlr_box output_box)
     {
         static wf::framebuffer_base_t default_framebuffer;
         default_framebuffer.tex = default_framebuffer.fb = 0;
 
-        int last_buffer_idx = default_out_buffer;
-        int next_buffer_idx = 1;
+        if (post_effects.size() == 0)
+            return;
 
-        post_effects.for_each([&] (auto post) -> void
+        if (buffers_damaged)
         {
-            /* The last postprocessing hook renders directly to the screen, others to
-             * the currently free buffer */
-            wf::framebuffer_base_t& next_buffer =
-                (post == post_effects.back() ? default_framebuffer :
-                 post_buffers[next_buffer_idx]);
+            damage |= output_box;
+            buffers_damaged = false;
+        }
 
-            OpenGL::render_begin();
-            /* Make sure we have the correct resolution */
-            next_buffer.allocate(output_width, output_height);
-            OpenGL::render_end();
+        /* Effects added since the buffers were allocated have no buffer yet,
+         * they run starting from the next frame */
+        size_t nr_effects = std::min(post_effects.size(), post_buffers.size());
+        size_t idx = 0;
+        post_effects.for_each([&] (const post_effect_t& effect) -> void
+        {
+            if (idx >= nr_effects)
+                return;
 
-            (*post) (post_buffers[last_buffer_idx], next_buffer);
+            /* The last postprocessing hook renders directly to the screen,
+             * others to their own buffer */
+            bool last = (idx + 1 == nr_effects);
+            wf::framebuffer_base_t& next_buffer =
+                (last ? default_framebuffer : post_buffers[idx + 1]);
 
-            last_buffer_idx = next_buffer_idx;
-            next_buffer_idx ^= 0b11; // alternate 1 and 2
+            damage = propagate_damage(effect, damage, output_box);
+            if (!damage.empty())
+            {
+                current_damage = get_framebuffer_damage(damage);
+                (*effect.hook) (post_buffers[idx], next_buffer);
+                current_damage.clear();
+            }
+
+            ++idx;
         });
     }
 
@@ -329,22 +606,286 @@ struct postprocessing_manager_t
     }
 };
 
+/**
+ * visibility_map_t caches, for each workspace of the output, which views are
+ * fully covered by opaque views above them. Workspace streams use it to skip
+ * these views before doing any per-surface work.
+ *
+ * The map is rebuilt lazily whenever core's visibility serial changes, i.e
+ * after stacking, geometry, opaque region or map state changes.
+ */
+struct visibility_map_t
+{
+    struct workspace_visibility_t
+    {
+        /* The visibility serial and the offset of desktop environment views
+         * the entry was computed with */
+        uint64_t serial = 0;
+        wf::point_t delta = {0, 0};
+        bool valid = false;
+        std::unordered_set<wf::view_interface_t*> occluded;
+    };
+
+    output_t *output;
+    std::vector<std::vector<workspace_visibility_t>> workspaces;
+
+    /* Number of views culled since the start of the current frame */
+    uint32_t culled_views = 0;
+
+    visibility_map_t(output_t *output)
+    {
+        this->output = output;
+        auto wsize = output->workspace->get_workspace_grid_size();
+        workspaces.resize(wsize.width);
+        for (auto& column : workspaces)
+            column.resize(wsize.height);
+    }
+
+    /**
+     * Rebuild the occlusion information for the given workspace by walking
+     * its views front to back and accumulating their opaque regions.
+     *
+     * Views with transformers and unmapped (snapshotted) views can change
+     * their appearance without notifying core, so they are never culled and
+     * never considered as occluders.
+     *
+     * @param delta The offset of desktop environment views on the workspace.
+     */
+    void rebuild(workspace_visibility_t& entry, wf::point_t ws,
+        wf::point_t delta)
+    {
+        entry.occluded.clear();
+
+        wf::region_t covered;
+        auto views = output->workspace->get_views_on_workspace(ws,
+            wf::VISIBLE_LAYERS, false);
+        for (auto& v : views)
+        {
+            for (auto& view : v->enumerate_views(false))
+            {
+                if (!view->is_visible() || !view->is_mapped() ||
+                    view->has_transformer())
+                {
+                    continue;
+                }
+
+                wf::point_t view_delta = {0, 0};
+                if (view->role == VIEW_ROLE_DESKTOP_ENVIRONMENT)
+                    view_delta = delta;
+
+                auto bbox = view->get_bounding_box() + view_delta;
+                if ((wf::region_t{bbox} ^ covered).empty())
+                {
+                    entry.occluded.insert(view.get());
+                    continue;
+                }
+
+                covered |= view->get_transformed_opaque_region() + view_delta;
+            }
+        }
+    }
+
+    /**
+     * Make sure the information for the given workspace is up-to-date.
+     * Must be called before is_occluded() for the same workspace.
+     */
+    void update(wf::point_t ws, wf::point_t delta)
+    {
+        auto& entry = workspaces[ws.x][ws.y];
+        auto serial = wf::get_core_impl().visibility_serial;
+        if (entry.valid && entry.serial == serial && entry.delta == delta)
+            return;
+
+        rebuild(entry, ws, delta);
+        entry.serial = serial;
+        entry.delta = delta;
+        entry.valid = true;
+    }
+
+    /** @return true if the view is fully covered on the given workspace. */
+    bool is_occluded(wf::point_t ws, wf::view_interface_t *view)
+    {
+        return workspaces[ws.x][ws.y].occluded.count(view);
+    }
+};
+
+frame_timings_t get_frame_timings_percentile(
+    const std::vector<frame_timings_t>& frames, double percentile)
+{
+    frame_timings_t result;
+    if (frames.empty())
+        return result;
+
+    percentile = wf::clamp(percentile, 0.0, 100.0);
+    size_t idx = std::round((frames.size() - 1) * percentile / 100.0);
+
+    std::vector<int64_t> values(frames.size());
+    auto select = [&] (auto field) -> int64_t
+    {
+        for (size_t i = 0; i < frames.size(); i++)
+            values[i] = field(frames[i]);
+
+        std::nth_element(values.begin(), values.begin() + idx, values.end());
+        return values[idx];
+    };
+
+    for (int i = 0; i < FRAME_PHASE_TOTAL; i++)
+    {
+        result.phase_usec[i] = select(
+            [=] (const frame_timings_t& f) { return f.phase_usec[i]; });
+    }
+
+    result.frame_usec = select(
+        [] (const frame_timings_t& f) { return f.frame_usec; });
+    result.rendered_surfaces = select(
+        [] (const frame_timings_t& f) { return f.rendered_surfaces; });
+    result.damaged_area = select(
+        [] (const frame_timings_t& f) { return f.damaged_area; });
+    result.fused_transformer_passes = select(
+        [] (const frame_timings_t& f) { return f.fused_transformer_passes; });
+
+    return result;
+}
+
+/**
+ * frame_profiler_t records how long the individual phases of a repaint take
+ * and keeps the timings of the last frames in a ring buffer.
+ */
+struct frame_profiler_t
+{
+    static constexpr size_t history_size = 256;
+    std::vector<frame_timings_t> history;
+    size_t next_frame = 0;
+
+    /* The frame which is currently being recorded */
+    frame_timings_t current;
+    int64_t frame_start, phase_start;
+    uint64_t fused_passes_start;
+
+    static int64_t get_current_usec()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000ll + ts.tv_nsec / 1000;
+    }
+
+    void start_frame()
+    {
+        current = {};
+        frame_start = phase_start = get_current_usec();
+        fused_passes_start = wf::get_fused_transformer_passes();
+    }
+
+    /** Finish the given phase, and start the next one */
+    void end_phase(frame_phase_t phase)
+    {
+        auto now = get_current_usec();
+        current.phase_usec[phase] += now - phase_start;
+        phase_start = now;
+    }
+
+    /** Store the current frame in the history */
+    const frame_timings_t& end_frame()
+    {
+        current.frame_usec = get_current_usec() - frame_start;
+        current.fused_transformer_passes =
+            wf::get_fused_transformer_passes() - fused_passes_start;
+        if (history.size() < history_size)
+        {
+            history.push_back(current);
+        } else
+        {
+            history[next_frame] = current;
+        }
+
+        next_frame = (next_frame + 1) % history_size;
+        return current;
+    }
+
+    frame_timings_t get_percentile(double percentile)
+    {
+        return get_frame_timings_percentile(history, percentile);
+    }
+};
+
+/**
+ * repaint_scheduler_t predicts how long the next frame will take to render,
+ * based on the render times of the last frames, so that repainting can be
+ * delayed until shortly before the next vblank.
+ */
+struct repaint_scheduler_t
+{
+    static constexpr size_t window_size = 16;
+    /* Minimal time to leave between the predicted end of a repaint and the
+     * next vblank */
+    static constexpr int64_t min_slack_usec = 1000;
+
+    int64_t samples[window_size] = {0};
+    size_t next_sample = 0;
+    size_t nr_samples = 0;
+
+    /** Record how long the last repaint took, in microseconds */
+    void add_sample(int64_t usec)
+    {
+        samples[next_sample] = usec;
+        next_sample = (next_sample + 1) % window_size;
+        nr_samples = std::min(nr_samples + 1, window_size);
+    }
+
+    /**
+     * Predict the cost of the next repaint. We take the worst of the last
+     * frames, with a safety margin, because a missed vblank is a lot worse
+     * than slightly higher latency.
+     *
+     * @return The predicted render time in microseconds, or -1 if there
+     *   isn't enough data yet.
+     */
+    int64_t predict() const
+    {
+        if (nr_samples < window_size / 2)
+            return -1;
+
+        int64_t worst = *std::max_element(samples, samples + nr_samples);
+        return worst + std::max(min_slack_usec, worst / 4);
+    }
+
+    /**
+     * @param refresh_nsec The refresh period of the output.
+     * @return How long to wait after a frame event before repainting, in
+     *   milliseconds.
+     */
+    int64_t get_repaint_delay(int64_t refresh_nsec) const
+    {
+        int64_t predicted = predict();
+        if (predicted < 0 || refresh_nsec <= 0)
+            return 0;
+
+        return std::max(int64_t(0), (refresh_nsec / 1000 - predicted) / 1000);
+    }
+};
+
 class wf::render_manager::impl
 {
   public:
     wf::wl_listener_wrapper on_frame;
     wf::wl_listener_wrapper on_present;
     wf::wl_timer repaint_timer;
-    int64_t refresh_nsec;
+    int64_t refresh_nsec = 0;
 
     output_t *output;
     wf::region_t swap_damage;
     std::unique_ptr<output_damage_t> output_damage;
     std::unique_ptr<effect_hook_manager_t> effects;
     std::unique_ptr<postprocessing_manager_t> postprocessing;
+    std::unique_ptr<visibility_map_t> visibility;
+    std::unique_ptr<frame_profiler_t> profiler;
+    std::unique_ptr<repaint_scheduler_t> scheduler;
 
     wf::option_wrapper_t<wf::color_t> background_color_opt;
     wf::option_wrapper_t<int> max_render_time_opt;
+    wf::option_wrapper_t<int> occluded_frame_rate_opt;
+    wf::option_wrapper_t<int> frame_timings_log_interval_opt;
+    wf::option_wrapper_t<int> gpu_memory_log_interval_opt;
 
     impl(output_t *o)
         : output(o)
@@ -352,6 +893,9 @@ class wf::render_manager::impl
         output_damage = std::make_unique<output_damage_t> (o);
         effects = std::make_unique<effect_hook_manager_t> ();
         postprocessing = std::make_unique<postprocessing_manager_t>(o);
+        visibility = std::make_unique<visibility_map_t>(o);
+        profiler = std::make_unique<frame_profiler_t>();
+        scheduler = std::make_unique<repaint_scheduler_t>();
 
         on_present.set_callback([&] (void *data) {
             auto ev = static_cast<wlr_output_event_present*> (data);
@@ -360,14 +904,16 @@ class wf::render_manager::impl
         on_present.connect(&output->handle->events.present);
 
         max_render_time_opt.load_option("core/max_render_time");
+        occluded_frame_rate_opt.load_option("core/occluded_frame_rate");
+        frame_timings_log_interval_opt.load_option(
+            "core/frame_timings_log_interval");
+        gpu_memory_log_interval_opt.load_option("core/gpu_memory_log_interval");
         on_frame.set_callback([&] (void*) {
             /*
              * Leave a bit of time for clients to render, see
              * https://github.com/swaywm/sway/pull/4588
              */
-            int64_t total = this->refresh_nsec / 1000000 - max_render_time_opt;
-            if (total <= 0 || max_render_time_opt <= 0 || this->renderer)
-                total = 0;
+            int64_t total = get_repaint_delay();
 
             // We cannot really wait less than 1ms, render right away in that case
             if (total < 1)
@@ -395,6 +941,27 @@ class wf::render_manager::impl
         output_damage->schedule_repaint();
     }
 
+    /**
+     * @return How long to wait after a frame event before repainting, in
+     *   milliseconds.
+     */
+    int64_t get_repaint_delay()
+    {
+        /* A negative max_render_time means the delay is computed from the
+         * render times of the last frames */
+        if (max_render_time_opt < 0)
+            return scheduler->get_repaint_delay(refresh_nsec);
+
+        /* Render hooks which repaint the whole output are too expensive to
+         * delay */
+        bool full_repaint = this->renderer && !renderer_tracks_damage;
+        if (max_render_time_opt == 0 || full_repaint)
+            return 0;
+
+        return std::max(int64_t(0),
+            refresh_nsec / 1000000 - (int64_t)max_render_time_opt);
+    }
+
     /* A stream for each workspace */
     std::vector<std::vector<workspace_stream_t>> default_streams;
     /* The stream pointing to the current workspace */
@@ -415,10 +982,32 @@ class wf::render_manager::impl
         }
     }
 
-    render_hook_t renderer;
+    damage_render_hook_t renderer;
+    /* Whether the renderer reports what it repainted, or repaints the whole
+     * output each frame */
+    bool renderer_tracks_damage = false;
     void set_renderer(render_hook_t rh)
+    {
+        if (rh)
+        {
+            set_damage_renderer([=] (const wf::framebuffer_t& fb,
+                const wf::region_t&)
+            {
+                rh(fb);
+                return wf::region_t{output->get_relative_geometry()};
+            });
+        } else
+        {
+            set_damage_renderer(nullptr);
+        }
+
+        renderer_tracks_damage = false;
+    }
+
+    void set_damage_renderer(damage_render_hook_t rh)
     {
         renderer = rh;
+        renderer_tracks_damage = true;
         output_damage->damage_whole_idle();
     }
 
@@ -529,9 +1118,16 @@ class wf::render_manager::impl
     {
         if (renderer)
         {
-            renderer(get_target_framebuffer());
-            /* TODO: let custom renderers specify what they want to repaint... */
-            swap_damage |= output_damage->get_wlr_damage_box();
+            /* The hook may reset the renderer while it is running */
+            auto hook = renderer;
+            auto repainted = hook(get_target_framebuffer(),
+                output_damage->get_scheduled_damage());
+            /* Hooks may repaint more than the damage, for ex. the whole
+             * output while animating. Older buffers need to get the same
+             * repaint when they are reused. */
+            output_damage->add_repainted(repainted);
+            swap_damage |= repainted * output->handle->scale;
+            swap_damage &= output_damage->get_wlr_damage_box();
         } else
         {
             swap_damage =
@@ -551,6 +1147,8 @@ class wf::render_manager::impl
         clockid_t presentation_clock =
             wlr_backend_get_presentation_clock(wf::get_core_impl().backend);
         clock_gettime(presentation_clock, &repaint_started);
+        visibility->culled_views = 0;
+        profiler->start_frame();
 
         effects->run_effects(OUTPUT_EFFECT_PRE);
 
@@ -572,23 +1170,25 @@ class wf::render_manager::impl
         }
 
         bind_output();
+        profiler->end_phase(FRAME_PHASE_DAMAGE);
 
         /* Part 2: call the renderer, which sets swap_damage and
          * draws the scenegraph */
         render_output();
+        profiler->end_phase(FRAME_PHASE_RENDER);
 
         /* Part 3: finalize the scene: overlay effects and sw cursors */
         effects->run_effects(OUTPUT_EFFECT_OVERLAY);
-
-        if (postprocessing->post_effects.size())
-            swap_damage |= output_damage->get_wlr_damage_box();
+        profiler->end_phase(FRAME_PHASE_OVERLAY);
 
         OpenGL::render_begin(get_target_framebuffer());
         wlr_output_render_software_cursors(output->handle, swap_damage.to_pixman());
         OpenGL::render_end();
+        profiler->end_phase(FRAME_PHASE_CURSORS);
 
         /* Part 4: postprocessing effects */
-        postprocessing->run_post_effects();
+        postprocessing->run_post_effects(swap_damage,
+            output_damage->get_wlr_damage_box());
         if (output_inhibit_counter)
         {
             OpenGL::render_begin(output->handle->width, output->handle->height, 0);
@@ -596,11 +1196,99 @@ class wf::render_manager::impl
             OpenGL::render_end();
         }
 
+        profiler->end_phase(FRAME_PHASE_POSTPROCESS);
+
         /* Part 5: finalize frame: swap buffers, send frame_done, etc */
+        for (const auto& rect : swap_damage)
+        {
+            profiler->current.damaged_area +=
+                int64_t(rect.x2 - rect.x1) * (rect.y2 - rect.y1);
+        }
+
         OpenGL::unbind_output(output);
         output_damage->swap_buffers(swap_damage);
         swap_damage.clear();
+        profiler->end_phase(FRAME_PHASE_SWAP);
+
         post_paint();
+        profiler->end_phase(FRAME_PHASE_FRAME_DONE);
+
+        auto& timings = profiler->end_frame();
+        scheduler->add_sample(
+            timings.frame_usec - timings.phase_usec[FRAME_PHASE_FRAME_DONE]);
+
+        frame_timings_signal data(timings);
+        static const wf::signal_id_t frame_timings{"frame-timings"};
+        output->render->emit_signal(frame_timings, &data);
+        log_frame_timings();
+        log_gpu_memory_usage();
+    }
+
+    int64_t last_timings_log = 0;
+    /**
+     * Periodically log statistics about the recent frames, if enabled
+     */
+    void log_frame_timings()
+    {
+        if (frame_timings_log_interval_opt <= 0)
+            return;
+
+        int64_t now = wf::get_current_time();
+        if (now - last_timings_log < frame_timings_log_interval_opt * 1000)
+            return;
+
+        last_timings_log = now;
+        auto p50 = profiler->get_percentile(50);
+        auto p99 = profiler->get_percentile(99);
+        auto ms = [] (int64_t usec) { return usec / 1000.0; };
+
+        LOGI("Frame timings on ", output->to_string(), " (p50/p99 ms): frame ",
+            ms(p50.frame_usec), "/", ms(p99.frame_usec),
+            ", render ", ms(p50.phase_usec[FRAME_PHASE_RENDER]), "/",
+            ms(p99.phase_usec[FRAME_PHASE_RENDER]),
+            ", postprocess ", ms(p50.phase_usec[FRAME_PHASE_POSTPROCESS]), "/",
+            ms(p99.phase_usec[FRAME_PHASE_POSTPROCESS]),
+            ", swap ", ms(p50.phase_usec[FRAME_PHASE_SWAP]), "/",
+            ms(p99.phase_usec[FRAME_PHASE_SWAP]),
+            ", frame_done ", ms(p50.phase_usec[FRAME_PHASE_FRAME_DONE]), "/",
+            ms(p99.phase_usec[FRAME_PHASE_FRAME_DONE]),
+            ", surfaces ", p50.rendered_surfaces, "/", p99.rendered_surfaces,
+            ", damaged px ", p50.damaged_area, "/", p99.damaged_area);
+    }
+
+    /**
+     * Periodically log the GPU memory used by offscreen buffers, if enabled.
+     * The accounting is global, so it is logged once for all outputs.
+     */
+    void log_gpu_memory_usage()
+    {
+        static int64_t last_log = 0;
+        if (gpu_memory_log_interval_opt <= 0)
+            return;
+
+        int64_t now = wf::get_current_time();
+        if (now - last_log < gpu_memory_log_interval_opt * 1000)
+            return;
+
+        last_log = now;
+        auto usage = OpenGL::get_gpu_memory_usage();
+        std::vector<std::pair<std::string, uint64_t>> sorted(
+            usage.begin(), usage.end());
+        std::sort(sorted.begin(), sorted.end(), [] (auto& a, auto& b) {
+            return a.second > b.second;
+        });
+
+        auto mib = [] (uint64_t bytes) { return bytes / (1024.0 * 1024.0); };
+        std::string details;
+        for (auto& entry : sorted)
+        {
+            char size[32];
+            snprintf(size, sizeof(size), "%.1f", mib(entry.second));
+            details += ", " + entry.first + " " + size;
+        }
+
+        LOGI("GPU memory usage (MiB): total ",
+            mib(OpenGL::get_total_gpu_memory_usage()), details);
     }
 
     /**
@@ -616,12 +1304,50 @@ class wf::render_manager::impl
         send_frame_done();
     }
 
+    /**
+     * Per-view state for throttling frame_done of occluded views
+     */
+    struct occluded_frame_state_t : public wf::custom_data_t
+    {
+        /* When frame_done was last sent to the view, in milliseconds */
+        int64_t last_frame_done = 0;
+    };
+
+    wf::wl_timer occluded_frame_timer;
+
+    /**
+     * @return The minimal interval in milliseconds between two frame_done
+     * events for the view while it is occluded, 0 if the view should not be
+     * throttled, or -1 if it should not get frame_done at all.
+     */
+    int64_t get_occluded_frame_interval(wayfire_view view)
+    {
+        int frame_rate = occluded_frame_rate_opt;
+        auto rate_override = view->get_data<occluded_frame_rate_t>();
+        if (rate_override)
+            frame_rate = rate_override->frame_rate;
+
+        if (frame_rate < 0)
+            return 0;
+        if (frame_rate == 0)
+            return -1;
+
+        return std::max(1000 / frame_rate, 1);
+    }
+
     /**
      * Send frame_done to clients.
+     *
+     * Views which are fully occluded on the current workspace get frame_done
+     * at a reduced rate, so that hidden clients do not keep rendering at the
+     * full refresh rate. With a custom renderer, we don't know what is
+     * visible on the screen, so no views are throttled.
+     *
+     * @param throttled_only Send frame_done only to occluded views whose
+     *   throttle interval has elapsed. Used when no repaint happens.
      */
-    void send_frame_done()
+    void send_frame_done(bool throttled_only = false)
     {
-        /* TODO: do this only if the view isn't fully occluded by another */
         std::vector<wayfire_view> visible_views;
         if (renderer)
         {
@@ -645,6 +1371,14 @@ class wf::render_manager::impl
         clockid_t presentation_clock =
             wlr_backend_get_presentation_clock(wf::get_core_impl().backend);
         clock_gettime(presentation_clock, &repaint_ended);
+        int64_t now = wf::timespec_to_msec(repaint_ended);
+
+        auto cws = output->workspace->get_current_workspace();
+        if (!renderer)
+            visibility->update(cws, {0, 0});
+
+        /* The shortest time after which a throttled view needs frame_done */
+        int64_t next_throttled_frame = -1;
         for (auto& v : visible_views)
         {
             for (auto& view : v->enumerate_views())
@@ -652,22 +1386,57 @@ class wf::render_manager::impl
                 if (!view->is_mapped())
                     continue;
 
+                auto state = view->get_data_safe<occluded_frame_state_t>();
+                bool occluded = !renderer &&
+                    visibility->is_occluded(cws, view.get());
+
+                int64_t interval = occluded ?
+                    get_occluded_frame_interval(view) : 0;
+                if (interval < 0 || (throttled_only && interval == 0))
+                    continue;
+
+                int64_t elapsed = now - state->last_frame_done;
+                if (interval > 0 && elapsed < interval)
+                {
+                    int64_t remaining = interval - elapsed;
+                    if (next_throttled_frame < 0 ||
+                        remaining < next_throttled_frame)
+                    {
+                        next_throttled_frame = remaining;
+                    }
+
+                    continue;
+                }
+
+                state->last_frame_done = now;
                 for (auto& child : view->enumerate_surfaces())
                     child.surface->send_frame_done(repaint_ended);
             }
         }
+
+        /* Throttled clients wait for frame_done before committing again, so
+         * there might not be another repaint soon. Make sure they still get
+         * their frame_done in time. */
+        if (next_throttled_frame > 0)
+        {
+            occluded_frame_timer.set_timeout(next_throttled_frame, [=] () {
+                send_frame_done(true);
+            });
+        }
     }
 
     /* Workspace stream implementation */
-    void workspace_stream_start(workspace_stream_t& stream)
+    void workspace_stream_start(workspace_stream_t& stream,
+        float scale_x = 1, float scale_y = 1)
     {
         stream.running = true;
-        stream.scale_x = stream.scale_y = 1;
+        stream.scale_x = stream.scale_y =
+            get_stream_render_scale(scale_x, scale_y);
 
         /* damage the whole workspace region, so that we get a full repaint
          * when updating the workspace */
         output_damage->damage(output_damage->get_ws_box(stream.ws));
-        workspace_stream_update(stream, 1, 1);
+        workspace_stream_update(stream, scale_x, scale_y);
     }
 
     /**
@@ -736,7 +1505,6 @@ class wf::render_manager::impl
         if (repaint.ws_damage.empty())
             return;
 
-        auto ds = damaged_surface(new damaged_surface_t);
         wlr_box obox = {
             .x = pos.x,
             .y = pos.y,
@@ -744,9 +1512,11 @@ class wf::render_manager::impl
             .height = surface->get_size().height
         };
 
-        ds->damage = repaint.ws_damage & obox;
-        if (!ds->damage.empty())
+        auto damage = repaint.ws_damage & obox;
+        if (!damage.empty())
         {
+            auto ds = damaged_surface(new damaged_surface_t);
+            ds->damage = std::move(damage);
             ds->pos = pos;
             ds->surface = surface;
 
@@ -798,6 +1568,10 @@ class wf::render_manager::impl
         auto views = output->workspace->get_views_on_workspace(stream.ws,
             wf::VISIBLE_LAYERS, false);
 
+        /* Views which are fully covered by opaque views above them are
+         * skipped entirely */
+        visibility->update(stream.ws, {repaint.ws_dx, repaint.ws_dy});
+
         schedule_drag_icon(repaint);
         for (auto& v : views)
         {
@@ -807,6 +1581,12 @@ class wf::render_manager::impl
                 if (!view->is_visible() || repaint.ws_damage.empty())
                     continue;
 
+                if (visibility->is_occluded(stream.ws, view.get()))
+                {
+                    ++visibility->culled_views;
+                    continue;
+                }
+
                 if (view->role == VIEW_ROLE_DESKTOP_ENVIRONMENT)
                     view_delta = {repaint.ws_dx, repaint.ws_dy};
 
@@ -835,6 +1615,22 @@ class wf::render_manager::impl
         }
     }
 
+    /**
+     * Streams which are displayed scaled down are rendered at a reduced
+     * resolution. The scale is rounded up to a multiple of this step, so that
+     * animating the scale does not reallocate the buffer on every frame.
+     */
+    static constexpr float STREAM_SCALE_STEP = 1.0f / 8;
+
+    /** @return The scale at which to render a stream displayed at the given
+     *  scale. The framebuffer scale is uniform, so the larger one is used. */
+    float get_stream_render_scale(float scale_x, float scale_y)
+    {
+        float scale = std::max(scale_x, scale_y);
+        scale = std::ceil(scale / STREAM_SCALE_STEP) * STREAM_SCALE_STEP;
+        return std::clamp(scale, STREAM_SCALE_STEP, 1.0f);
+    }
+
     /**
      * Setup the stream, calculate damaged region, etc.
      */
@@ -844,21 +1640,27 @@ class wf::render_manager::impl
         workspace_stream_repaint_t repaint;
         repaint.ws_damage = output_damage->get_ws_damage(stream.ws);
 
+        float scale = get_stream_render_scale(scale_x, scale_y);
+        if (scale != stream.scale_x || scale != stream.scale_y)
+        {
+            /* The buffer is reallocated with the new size, so its contents
+             * need to be fully repainted, also when zooming back in */
+            stream.scale_x = stream.scale_y = scale;
+            repaint.ws_damage |= output_damage->get_ws_box(stream.ws);
+        }
+
         /* we don't have to update anything */
         if (repaint.ws_damage.empty())
             return repaint;
 
-        if (scale_x != stream.scale_x || scale_y != stream.scale_y)
-        {
-            /* FIXME: enable scaled rendering */
-            //        stream->scale_x = scale_x;
-            //        stream->scale_y = scale_y;
+        int width = std::ceil(output->handle->width * scale);
+        int height = std::ceil(output->handle->height * scale);
 
-            //   ws_damage |= get_damage_box();
-        }
+        if (stream.buffer.owner.empty())
+            stream.buffer.owner = "workspace-stream";
 
         OpenGL::render_begin();
-        stream.buffer.allocate(output->handle->width, output->handle->height);
+        stream.buffer.allocate(width, height);
         OpenGL::render_end();
 
         repaint.fb = get_target_framebuffer();
@@ -867,6 +1669,9 @@ class wf::render_manager::impl
             /* Use the workspace buffers */
             repaint.fb.fb = stream.buffer.fb;
             repaint.fb.tex = stream.buffer.tex;
+            repaint.fb.viewport_width = width;
+            repaint.fb.viewport_height = height;
+            repaint.fb.scale *= scale;
         }
 
         auto g = output->get_relative_geometry();
@@ -903,6 +1708,7 @@ class wf::render_manager::impl
     void render_views(workspace_stream_repaint_t& repaint)
     {
         wf::geometry_t fb_geometry = repaint.fb.geometry;
+        profiler->current.rendered_surfaces += repaint.to_render.size();
 
         for (auto& ds : wf::reverse(repaint.to_render))
         {
@@ -937,7 +1743,8 @@ class wf::render_manager::impl
 
         {
             stream_signal_t data(stream.ws, repaint.ws_damage, repaint.fb);
-            output->render->emit_signal("workspace-stream-pre", &data);
+            static const wf::signal_id_t stream_pre{"workspace-stream-pre"};
+            output->render->emit_signal(stream_pre, &data);
         }
 
         check_schedule_surfaces(repaint, stream);
@@ -954,13 +1761,26 @@ class wf::render_manager::impl
         unschedule_drag_icon();
         {
             stream_signal_t data(stream.ws, repaint.ws_damage, repaint.fb);
-            output->render->emit_signal("workspace-stream-post", &data);
+            static const wf::signal_id_t stream_post{"workspace-stream-post"};
+            output->render->emit_signal(stream_post, &data);
         }
     }
 
     void workspace_stream_stop(workspace_stream_t& stream)
     {
         stream.running = false;
+
+        /* The stream is fully repainted when it is started again, so its
+         * buffer can be freed if memory is tight. The default buffer is
+         * the output's framebuffer and must be kept. */
+        bool owns_buffer = stream.buffer.fb != 0 &&
+            stream.buffer.fb != (GLuint)-1;
+        if (owns_buffer && OpenGL::is_gpu_memory_over_budget())
+        {
+            OpenGL::render_begin();
+            stream.buffer.release();
+            OpenGL::render_end();
+        }
     }
 };
 
@@ -968,14 +1788,20 @@ render_manager::render_manager(output_t *o)
     : pimpl(new impl(o)) { }
 render_manager::~render_manager() = default;
 void render_manager::set_renderer(render_hook_t rh) { pimpl->set_renderer(rh); }
+void render_manager::set_damage_renderer(damage_render_hook_t rh) { pimpl->set_damage_renderer(rh); }
 void render_manager::set_redraw_always(bool always) { pimpl->set_redraw_always(always); }
 wf::region_t render_manager::get_swap_damage() { return pimpl->get_swap_damage(); }
+wf::region_t render_manager::get_post_damage() { return pimpl->postprocessing->current_damage; }
+uint32_t render_manager::get_culled_views_count() { return pimpl->visibility->culled_views; }
+frame_timings_t render_manager::get_frame_timings_percentile(double percentile) { return pimpl->profiler->get_percentile(percentile); }
 void render_manager::schedule_redraw() { pimpl->output_damage->schedule_repaint(); }
 void render_manager::add_inhibit(bool add) { pimpl->add_inhibit(add); }
 void render_manager::add_effect(effect_hook_t* hook, output_effect_type_t type) {pimpl->effects->add_effect(hook, type); }
 void render_manager::rem_effect(effect_hook_t* hook) { pimpl->effects->rem_effect(hook); }
-void render_manager::add_post(post_hook_t* hook) { pimpl->postprocessing->add_post(hook); }
+void render_manager::add_post(post_hook_t* hook, post_damage_t damage) { pimpl->postprocessing->add_post(hook, damage); }
 void render_manager::rem_post(post_hook_t* hook) { pimpl->postprocessing->rem_post(hook); }
+void render_manager::add_post_shader(post_shader_t* shader) { pimpl->postprocessing->add_post_shader(shader); }
+void render_manager::rem_post_shader(post_shader_t* shader) { pimpl->postprocessing->rem_post_shader(shader); }
 wf::region_t render_manager::get_scheduled_damage() { return pimpl->output_damage->get_scheduled_damage(); }
 void render_manager::damage_whole() { pimpl->output_damage->damage_whole(); }
 void render_manager::damage_whole_idle() { pimpl->output_damage->damage_whole_idle(); }
@@ -983,9 +1809,10 @@ void render_manager::damage(const wlr_box& box) { pimpl->output_damage->damage(b
 void render_manager::damage(const wf::region_t& region) { pimpl->output_damage->damage(region); }
 wlr_box render_manager::get_ws_box(wf::point_t ws) const { return pimpl->output_damage->get_ws_box(ws); }
 wf::framebuffer_t render_manager::get_target_framebuffer() const { return pimpl->get_target_framebuffer(); }
-void render_manager::workspace_stream_start(workspace_stream_t& stream) { pimpl->workspace_stream_start(stream); }
+void render_manager::workspace_stream_start(workspace_stream_t& stream,
+    float scale_x, float scale_y) { pimpl->workspace_stream_start(stream, scale_x, scale_y); }
 void render_manager::workspace_stream_update(workspace_stream_t& stream,
-    float scale_x, float scale_y){ pimpl->workspace_stream_update(stream); }
+    float scale_x, float scale_y){ pimpl->workspace_stream_update(stream, scale_x, scale_y); }
 void render_manager::workspace_stream_stop(workspace_stream_t& stream) { pimpl->workspace_stream_stop(stream); }
 
 } // namespace wf
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <wayfire/nonstd/reverse.hpp>
 #include <wayfire/util/log.hpp>
+#include "../core/core-impl.hpp"
 
 namespace wf
 {
@@ -52,6 +53,7 @@ class output_layer_manager_t
         layer_container.erase(it, layer_container.end());
 
         view_layer = 0;
+        wf::get_core_impl().invalidate_visibility();
     }
 
     /**
@@ -69,6 +71,7 @@ class output_layer_manager_t
         layer_container.push_front(view);
         current_layer = layer;
         view->damage();
+        wf::get_core_impl().invalidate_visibility();
     }
 
     void bring_to_front(wayfire_view view)
@@ -97,6 +100,7 @@ class output_layer_manager_t
 
         container.insert(it, view);
         get_view_layer(view) = layer;
+        wf::get_core_impl().invalidate_visibility();
     }
 
     void restack_below(wayfire_view view, wayfire_view above)
@@ -109,6 +113,7 @@ class output_layer_manager_t
 
         container.insert(std::next(it), view);
         get_view_layer(view) = layer;
+        wf::get_core_impl().invalidate_visibility();
     }
 
     std::vector<wayfire_view> get_views_in_layer(uint32_t layers_mask)
@@ -5,6 +5,7 @@
 #include <wayfire/signal-definitions.hpp>
 #include <wayfire/debug.hpp>
 #include <cstring>
+#include "../core/core-impl.hpp"
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -102,7 +103,9 @@ void wf::mirror_view_t::move(int x, int y)
     this->y = y;
 
     damage();
-    emit_signal("geometry-changed", &data);
+    wf::get_core_impl().invalidate_visibility();
+    static const wf::signal_id_t geometry_changed{"geometry-changed"};
+    emit_signal(geometry_changed, &data);
 }
 
 wf::geometry_t wf::mirror_view_t::get_output_geometry()
@@ -231,7 +234,9 @@ void wf::color_rect_view_t::move(int x, int y)
     this->geometry.y = y;
 
     damage();
-    emit_signal("geometry-changed", &data);
+    wf::get_core_impl().invalidate_visibility();
+    static const wf::signal_id_t geometry_changed{"geometry-changed"};
+    emit_signal(geometry_changed, &data);
 }
 
 void wf::color_rect_view_t::resize(int w, int h)
@@ -244,7 +249,9 @@ void wf::color_rect_view_t::resize(int w, int h)
     this->geometry.height = h;
 
     damage();
-    emit_signal("geometry-changed", &data);
+    wf::get_core_impl().invalidate_visibility();
+    static const wf::signal_id_t geometry_changed{"geometry-changed"};
+    emit_signal(geometry_changed, &data);
 }
 
 wf::geometry_t wf::color_rect_view_t::get_output_geometry()
@@ -45,6 +45,10 @@ class wlr_surface_base_t
 
     void apply_surface_damage();
     wlr_surface_base_t(wf::surface_interface_t *self);
+
+    /** The size and opaque region of the surface at the last commit */
+    wf::dimensions_t last_size = {0, 0};
+    wf::region_t last_opaque_region;
     /* Pointer to this as surface_interface, see requirement above */
     wf::surface_interface_t *_as_si = nullptr;
 
@@ -124,6 +124,9 @@ void wf::surface_interface_t::set_opaque_shrink_constraint(
         impl::active_shrink_constraint =
             std::max(impl::active_shrink_constraint, constr.second);
     }
+
+    /* The opaque region of all surfaces depends on the shrink constraint */
+    wf::get_core_impl().invalidate_visibility();
 }
 
 int wf::surface_interface_t::get_active_shrink_constraint()
@@ -276,6 +279,7 @@ void wf::wlr_surface_base_t::map(wlr_surface *surface)
     wl_list_for_each(sub, &surface->subsurfaces, parent_link)
         handle_new_subsurface(sub);
 
+    wf::get_core_impl().invalidate_visibility();
     emit_map_state_change(_as_si);
 }
 
@@ -289,6 +293,7 @@ void wf::wlr_surface_base_t::unmap()
     this->surface->data = NULL;
     this->surface = nullptr;
     this->_as_si->priv->wsurface = nullptr;
+    wf::get_core_impl().invalidate_visibility();
     emit_map_state_change(_as_si);
 
     on_new_subsurface.disconnect();
@@ -322,6 +327,17 @@ void wf::wlr_surface_base_t::apply_surface_damage()
 void wf::wlr_surface_base_t::commit()
 {
     apply_surface_damage();
+
+    /* Content-only commits do not change which views are occluded, so check
+     * explicitly for changes of the size and the opaque region. */
+    if (_get_size() != last_size || !pixman_region32_equal(
+            &surface->opaque_region, last_opaque_region.to_pixman()))
+    {
+        last_size = _get_size();
+        last_opaque_region = wf::region_t{&surface->opaque_region};
+        wf::get_core_impl().invalidate_visibility();
+    }
+
     if (_as_si->get_output())
     {
         /* we schedule redraw, because the surface might expect
@@ -352,11 +368,7 @@ void wf::wlr_surface_base_t::_simple_render(const wf::framebuffer_t& fb,
     wf::texture_t texture{surface->buffer->texture};
 
     OpenGL::render_begin(fb);
-    for (const auto& rect : damage)
-    {
-        fb.logic_scissor(wlr_box_from_pixman_box(rect));
-        OpenGL::render_texture(texture, fb, geometry);
-    }
+    OpenGL::render_texture_batched(texture, fb, geometry, damage);
     OpenGL::render_end();
 }
 
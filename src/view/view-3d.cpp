@@ -44,11 +44,13 @@ struct transformable_quad
     float off_x, off_y;
 };
 
-static wf::point_t get_center(wf::geometry_t view)
+/* The center is not rounded, so that it is the same as the center used by
+ * get_center_relative_coords() and the fused transforms */
+static wf::pointf_t get_center(wf::geometry_t view)
 {
     return {
-        view.x + view.width / 2,
-        view.y + view.height/ 2
+        view.x + view.width / 2.0,
+        view.y + view.height / 2.0
     };
 }
 
@@ -70,7 +72,7 @@ static wf::pointf_t get_absolute_coords_from_relative(wf::geometry_t view, wf::p
 
 static transformable_quad center_geometry(wf::geometry_t output_geometry,
                                           wf::geometry_t geometry,
-                                          wf::point_t target_center)
+                                          wf::pointf_t target_center)
 {
     transformable_quad quad;
 
@@ -92,6 +94,21 @@ static transformable_quad center_geometry(wf::geometry_t output_geometry,
     return quad;
 }
 
+/* Convert output-local coordinates to coordinates relative to the given
+ * center with the Y axis pointing up, like get_center_relative_coords() */
+static glm::mat4 to_center_relative(wf::pointf_t center)
+{
+    return glm::scale(glm::mat4(1.0), {1, -1, 1}) *
+        glm::translate(glm::mat4(1.0), {-center.x, -center.y, 0});
+}
+
+/* The inverse of to_center_relative() */
+static glm::mat4 from_center_relative(wf::pointf_t center)
+{
+    return glm::translate(glm::mat4(1.0), {center.x, center.y, 0}) *
+        glm::scale(glm::mat4(1.0), {1, -1, 1});
+}
+
 wf::view_2D::view_2D(wayfire_view view)
 {
     this->view = view;
@@ -163,6 +180,22 @@ void wf::view_2D::render_box(wf::texture_t src_tex, wlr_box src_box,
     OpenGL::render_end();
 }
 
+bool wf::view_2D::get_fused_transform(wf::geometry_t src_box,
+    glm::mat4& matrix, glm::vec4& color)
+{
+    auto center = get_center(view->get_wm_geometry());
+
+    auto scale = glm::scale(glm::mat4(1.0), {scale_x, scale_y, 1});
+    auto rotate = glm::rotate(glm::mat4(1.0), angle, {0, 0, 1});
+    auto translate = glm::translate(glm::mat4(1.0),
+        {translation_x, -translation_y, 0});
+
+    matrix = from_center_relative(center) * translate * rotate * scale *
+        to_center_relative(center);
+    color = {1.0f, 1.0f, 1.0f, alpha};
+    return true;
+}
+
 const float wf::view_3D::fov = PI/4;
 glm::mat4 wf::view_3D::default_view_matrix()
 {
@@ -232,3 +265,13 @@ void wf::view_3D::render_box(wf::texture_t src_tex, wlr_box src_box,
                                        transform, color);
     OpenGL::render_end();
 }
+
+bool wf::view_3D::get_fused_transform(wf::geometry_t src_box,
+    glm::mat4& matrix, glm::vec4& color)
+{
+    auto center = get_center(src_box);
+    matrix = from_center_relative(center) * calculate_total_transform() *
+        to_center_relative(center);
+    color = this->color;
+    return true;
+}
@@ -132,9 +132,11 @@ void wf::wlr_view_t::set_position(int x, int y,
     }
 
     damage();
+    wf::get_core_impl().invalidate_visibility();
 
+    static const wf::signal_id_t geometry_changed{"geometry-changed"};
     if (send_signal)
-        emit_signal("geometry-changed", &data);
+        emit_signal(geometry_changed, &data);
 
     last_bounding_box = get_bounding_box();
 }
@@ -185,7 +187,9 @@ void wf::wlr_view_t::update_size()
     /* Damage new size */
     last_bounding_box = get_bounding_box();
     view_damage_raw(self(), last_bounding_box);
-    emit_signal("geometry-changed", &data);
+    wf::get_core_impl().invalidate_visibility();
+    static const wf::signal_id_t geometry_changed{"geometry-changed"};
+    emit_signal(geometry_changed, &data);
 
     if (view_impl->frame)
         view_impl->frame->notify_view_resized(get_wm_geometry());
@@ -256,7 +260,12 @@ void wf::wlr_view_t::commit()
     if (!view_impl->in_continuous_resize)
         view_impl->edges = 0;
 
-    this->last_bounding_box = get_bounding_box();
+    /* Subsurfaces and popups may have moved or changed their size */
+    auto new_bounding_box = get_bounding_box();
+    if (new_bounding_box != this->last_bounding_box)
+        wf::get_core_impl().invalidate_visibility();
+
+    this->last_bounding_box = new_bounding_box;
 }
 
 void wf::wlr_view_t::map(wlr_surface *surface)
@@ -10,6 +10,7 @@
 #include "wayfire/render-manager.hpp"
 #include "xdg-shell.hpp"
 #include "../output/gtk-shell.hpp"
+#include "../core/seat/view-hit-index.hpp"
 
 #include <algorithm>
 #include <glm/glm.hpp>
@@ -154,6 +155,7 @@ void wf::view_interface_t::set_role(view_role_t new_role)
 {
     role = new_role;
     damage();
+    wf::get_core_impl().invalidate_visibility();
 }
 
 std::string wf::view_interface_t::to_string() const
@@ -654,6 +656,7 @@ void wf::view_interface_t::add_transformer(
     auto tr = std::make_shared<wf::view_transform_block_t> ();
     tr->transform = std::move(transformer);
     tr->plugin_name = name;
+    tr->fb.owner = "transformer " + name;
 
     view_impl->transforms.emplace_at(std::move(tr), [&] (auto& other)
     {
@@ -663,6 +666,7 @@ void wf::view_interface_t::add_transformer(
     });
 
     damage();
+    wf::get_core_impl().invalidate_visibility();
 }
 
 nonstd::observer_ptr<wf::view_transformer_t>
@@ -685,6 +689,7 @@ void wf::view_interface_t::pop_transformer(
     {
         return tr->transform.get() == transformer.get();
     });
+    wf::get_core_impl().invalidate_visibility();
 
     /* Since we can remove transformers while rendering the output, damaging it
      * won't help at this stage (damage is already calculated).
@@ -823,6 +828,12 @@ wf::region_t wf::view_interface_t::get_transformed_opaque_region()
     return opaque;
 }
 
+static uint64_t fused_transformer_passes = 0;
+uint64_t wf::get_fused_transformer_passes()
+{
+    return fused_transformer_passes;
+}
+
 bool wf::view_interface_t::render_transformed(const wf::framebuffer_t& framebuffer,
     const wf::region_t& damage)
 {
@@ -858,14 +869,114 @@ bool wf::view_interface_t::render_transformed(const wf::framebuffer_t& framebuff
     /* final_transform is the one that should render to the screen */
     std::shared_ptr<view_transform_block_t> final_transform = nullptr;
 
+    /* Consecutive transformers which can be described by a matrix are not
+     * rendered immediately, but accumulated here and then rendered in a
+     * single pass */
+    struct
+    {
+        std::shared_ptr<view_transform_block_t> last;
+        int count = 0;
+        wf::texture_t texture;
+        wf::geometry_t src_box;
+        glm::mat4 matrix;
+        glm::vec4 color;
+    } fused;
+
+    /* The view texture has z = 0, so the z coordinate has to be dropped
+     * after each transformer, like when rendering to a buffer in between */
+    static const glm::mat4 flatten_z = glm::scale(glm::mat4(1.0), {1, 1, 0});
+
+    auto render_fused = [&] (const wf::region_t& region,
+        const wf::framebuffer_t& target_fb)
+    {
+        if (fused.count == 1)
+        {
+            fused.last->transform->render_with_damage(fused.texture,
+                fused.src_box, region, target_fb);
+        } else
+        {
+            auto matrix = target_fb.get_orthographic_projection() * fused.matrix;
+            gl_geometry src_geometry = {
+                1.0f * fused.src_box.x, 1.0f * fused.src_box.y,
+                1.0f * fused.src_box.x + 1.0f * fused.src_box.width,
+                1.0f * fused.src_box.y + 1.0f * fused.src_box.height,
+            };
+
+            OpenGL::render_begin(target_fb);
+            for (const auto& rect : region)
+            {
+                target_fb.logic_scissor(wlr_box_from_pixman_box(rect));
+                OpenGL::render_transformed_texture(fused.texture, src_geometry,
+                    {}, matrix, fused.color);
+            }
+
+            OpenGL::render_end();
+            fused_transformer_passes += fused.count - 1;
+        }
+
+        fused.count = 0;
+    };
+
+    /* Render to the buffer of the given transform, which covers box */
+    auto render_offscreen = [&] (std::shared_ptr<view_transform_block_t> transform,
+        wf::geometry_t box, auto render)
+    {
+        int scaled_width = box.width * texture_scale;
+        int scaled_height = box.height * texture_scale;
+
+        /* Prepare buffer to store result after the transform */
+        OpenGL::render_begin();
+        transform->fb.allocate(scaled_width, scaled_height);
+        transform->fb.scale = texture_scale;
+        transform->fb.geometry = box;
+        transform->fb.bind(); // bind buffer to clear it
+        OpenGL::clear({0, 0, 0, 0});
+        OpenGL::render_end();
+
+        render(wf::region_t{box}, transform->fb);
+
+        previous_transform = transform;
+        previous_texture = previous_transform->fb.tex;
+    };
+
     /* Render the view passing its snapshot through the transformers.
      * For each transformer except the last we render on offscreen buffers,
      * and the last one is rendered to the real fb. */
     auto& transforms = view_impl->transforms;
     transforms.for_each([&] (auto& transform) -> void
     {
+        bool is_last = (transform == transforms.back());
+
+        glm::mat4 matrix;
+        glm::vec4 color;
+        if (transform->transform->get_fused_transform(obox, matrix, color))
+        {
+            if (fused.count == 0)
+            {
+                fused.texture = previous_texture;
+                fused.src_box = obox;
+                fused.matrix = glm::mat4(1.0);
+                fused.color = glm::vec4(1.0);
+            }
+
+            fused.last = transform;
+            fused.count++;
+            fused.matrix = matrix * flatten_z * fused.matrix;
+            fused.color *= color;
+
+            /* The last transform is rendered directly to the framebuffer */
+            if (!is_last)
+                obox = transform->transform->get_bounding_box(obox, obox);
+
+            return;
+        }
+
+        /* Render the pending transforms, whose output is this one's input */
+        if (fused.count > 0)
+            render_offscreen(fused.last, obox, render_fused);
+
         /* Last transform is handled separately */
-        if (transform == transforms.back())
+        if (is_last)
         {
             final_transform = transform;
             return;
@@ -874,51 +985,38 @@ bool wf::view_interface_t::render_transformed(const wf::framebuffer_t& framebuff
         /* Calculate size after this transform */
         auto transformed_box =
             transform->transform->get_bounding_box(obox, obox);
-        int scaled_width = transformed_box.width * texture_scale;
-        int scaled_height = transformed_box.height * texture_scale;
-
-        /* Prepare buffer to store result after the transform */
-        OpenGL::render_begin();
-        transform->fb.allocate(scaled_width, scaled_height);
-        transform->fb.scale = texture_scale;
-        transform->fb.geometry = transformed_box;
-        transform->fb.bind(); // bind buffer to clear it
-        OpenGL::clear({0, 0, 0, 0});
-        OpenGL::render_end();
 
         /* Actually render the transform to the next framebuffer */
-        transform->transform->render_with_damage(previous_texture, obox,
-            wf::region_t{transformed_box}, transform->fb);
+        auto src_box = obox;
+        render_offscreen(transform, transformed_box,
+            [&] (const wf::region_t& region, const wf::framebuffer_t& fb)
+        {
+            transform->transform->render_with_damage(previous_texture, src_box,
+                region, fb);
+        });
 
-        previous_transform = transform;
-        previous_texture = previous_transform->fb.tex;
         obox = transformed_box;
     });
 
-    /* This can happen in two ways:
+    /* This can happen in three ways:
      * 1. The view is unmapped, and no snapshot
      * 2. The last transform was deleted while iterating, so now the last
      *    transform is invalid in the list
+     * 3. The last transforms are being fused
      *
-     * In both cases, we simply render whatever contents we have to the
-     * framebuffer. */
+     * In the first two cases, we simply render whatever contents we have to
+     * the framebuffer. */
     if (final_transform == nullptr)
     {
-        OpenGL::render_begin(framebuffer);
-        auto matrix = framebuffer.get_orthographic_projection();
-        gl_geometry src_geometry = {
-            1.0f * obox.x, 1.0f * obox.y,
-            1.0f * obox.x + 1.0f * obox.width,
-            1.0f * obox.y + 1.0f * obox.height,
-        };
-
-        for (const auto& rect : damage)
+        if (fused.count > 0)
         {
-            framebuffer.logic_scissor(wlr_box_from_pixman_box(rect));
-            OpenGL::render_transformed_texture(previous_texture, src_geometry,
-                {}, matrix);
+            render_fused(damage, framebuffer);
+            return true;
         }
 
+        OpenGL::render_begin(framebuffer);
+        OpenGL::render_texture_batched(previous_texture, framebuffer, obox,
+            damage);
         OpenGL::render_end();
     } else
     {
@@ -964,6 +1062,7 @@ void wf::view_interface_t::take_snapshot()
         offscreen_buffer.cached_damage |= buffer_geometry;
     }
 
+    offscreen_buffer.owner = "view-snapshot";
     OpenGL::render_begin();
     offscreen_buffer.allocate(scaled_width, scaled_height);
     offscreen_buffer.scale = scale;
@@ -1061,6 +1160,15 @@ void wf::view_damage_raw(wayfire_view view, const wlr_box& box)
     if (!output)
         return;
 
+    /* Transformers may change the input region of the view without any
+     * other notification */
+    if (view->has_transformer())
+    {
+        auto hit_index = output->get_data<wf::view_hit_index_t>();
+        if (hit_index)
+            hit_index->invalidate();
+    }
+
     /* shell views are visible in all workspaces. That's why we must apply
      * their damage to all workspaces as well */
     if (view->role == wf::VIEW_ROLE_DESKTOP_ENVIRONMENT)
@@ -1086,7 +1194,8 @@ void wf::view_damage_raw(wayfire_view view, const wlr_box& box)
         output->render->damage(box);
     }
 
-    view->emit_signal("damaged-region", nullptr);
+    static const wf::signal_id_t damaged_region{"damaged-region"};
+    view->emit_signal(damaged_region, nullptr);
 }
 
 void wf::view_interface_t::destruct()